@@ -0,0 +1,25 @@
+#ifdef OPEN_DYLAN_PLATFORM_WINDOWS
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+int common_dylan_concurrent_thread_count(void)
+{
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (int)info.dwNumberOfProcessors;
+}
+
+#else
+
+#include <unistd.h>
+
+/* The system library has its own copy of this, but it is built on
+ * common-dylan so common-dylan can't use it. */
+int common_dylan_concurrent_thread_count(void)
+{
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count < 0 ? 0 : (int)count;
+}
+
+#endif
@@ -0,0 +1,198 @@
+/* Event counters for the profiling macro's counter types.  The counter
+ * numbers match $profiling-counters in counter-profiling.dylan.
+ *
+ * common_dylan_counter_read returns the current value of a counter for
+ * the calling thread, or -1 if the counter is not available.  Values
+ * only mean anything relative to each other, and are limited to the
+ * range of a Dylan <integer>.
+ */
+
+#define COUNTER_CYCLES              0
+#define COUNTER_INSTRUCTIONS        1
+#define COUNTER_CACHE_MISSES        2
+#define COUNTER_BRANCH_MISSES       3
+#define COUNTER_PAGE_FAULTS         4
+#define COUNTER_PROCESS_PAGE_FAULTS 5
+#define COUNTER_COUNT               6
+
+#if defined(OPEN_DYLAN_PLATFORM_LINUX)
+
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+/* The hardware and software events are counted by perf_event_open in
+ * self-monitoring mode, for the calling thread in user space only, so
+ * that no privileges are needed unless perf_event_paranoid is 3 or
+ * more.  Each thread opens a counter the first time it reads it, and
+ * keeps it open and running.  Where the kernel allows it, the count is
+ * then read with rdpmc from user space instead of with a system call.
+ * The counters are closed again when the thread exits.
+ */
+
+typedef struct counter {
+  int state;                    /* 0 unopened, 1 open, -1 unavailable */
+  int fd;
+  struct perf_event_mmap_page *page;
+} COUNTER;
+
+static __thread COUNTER counters[COUNTER_COUNT];
+
+static pthread_key_t counters_key;
+static pthread_once_t counters_key_once = PTHREAD_ONCE_INIT;
+static int counters_key_created = 0;
+
+static const struct {
+  uint32_t type;
+  uint64_t config;
+} counter_events[] = {
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+  { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+};
+
+/* The destructor of counters_key, run as a thread that opened a
+ * counter exits, with that thread's counters array. */
+static void counters_close(void *value)
+{
+  COUNTER *thread_counters = value;
+  for (int number = 0; number < COUNTER_COUNT; ++number) {
+    COUNTER *counter = &thread_counters[number];
+    if (counter->state > 0) {
+      if (counter->page != NULL) {
+        munmap(counter->page, (size_t) sysconf(_SC_PAGESIZE));
+      }
+      close(counter->fd);
+    }
+    counter->state = 0;
+    counter->fd = -1;
+    counter->page = NULL;
+  }
+}
+
+static void counters_key_create(void)
+{
+  counters_key_created = pthread_key_create(&counters_key, counters_close) == 0;
+}
+
+static int counter_open(COUNTER *counter, int number)
+{
+  /* Without a destructor the counter would outlive the thread */
+  pthread_once(&counters_key_once, counters_key_create);
+  if (!counters_key_created
+      || pthread_setspecific(counters_key, counters) != 0) {
+    return -1;
+  }
+
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof attr);
+  attr.size = sizeof attr;
+  attr.type = counter_events[number].type;
+  attr.config = counter_events[number].config;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+
+  int fd = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  if (fd < 0) {
+    return -1;
+  }
+
+  /* The first page describes the counter, which rdpmc needs */
+  void *page = mmap(NULL, (size_t) sysconf(_SC_PAGESIZE), PROT_READ,
+                    MAP_SHARED, fd, 0);
+  counter->page = page == MAP_FAILED ? NULL : page;
+  counter->fd = fd;
+  return 0;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+static inline uint64_t rdpmc(uint32_t index)
+{
+  uint32_t low, high;
+  __asm__ volatile ("rdpmc" : "=a" (low), "=d" (high) : "c" (index));
+  return (uint64_t) high << 32 | low;
+}
+
+/* The kernel's protocol for reading a counter from user space; see
+ * linux/perf_event.h.  Returns 0 if the counter can't be read this way
+ * at the moment. */
+static int counter_read_rdpmc(struct perf_event_mmap_page *page,
+                              uint64_t *value)
+{
+  uint32_t seq;
+  uint64_t count;
+  do {
+    seq = page->lock;
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+    uint32_t index = page->index;
+    if (!page->cap_user_rdpmc || index == 0) {
+      return 0;
+    }
+    count = (uint64_t) page->offset;
+    uint64_t pmc = rdpmc(index - 1);
+    uint16_t width = page->pmc_width;
+    pmc <<= 64 - width;
+    count += (uint64_t) ((int64_t) pmc >> (64 - width));
+    __atomic_signal_fence(__ATOMIC_SEQ_CST);
+  } while (page->lock != seq);
+  *value = count;
+  return 1;
+}
+#else
+static int counter_read_rdpmc(struct perf_event_mmap_page *page,
+                              uint64_t *value)
+{
+  return 0;
+}
+#endif
+
+long common_dylan_counter_read(int number)
+{
+  uint64_t value;
+
+  if (number == COUNTER_PROCESS_PAGE_FAULTS) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+      return -1;
+    }
+    value = (uint64_t) usage.ru_minflt + (uint64_t) usage.ru_majflt;
+  }
+  else if (number >= 0 && number < COUNTER_COUNT) {
+    COUNTER *counter = &counters[number];
+    if (counter->state == 0) {
+      counter->state = counter_open(counter, number) == 0 ? 1 : -1;
+    }
+    if (counter->state < 0) {
+      return -1;
+    }
+    if (counter->page == NULL || !counter_read_rdpmc(counter->page, &value)) {
+      if (read(counter->fd, &value, sizeof value) != sizeof value) {
+        return -1;
+      }
+    }
+  }
+  else {
+    return -1;
+  }
+
+  /* Keep within a Dylan <integer> */
+  return (long) (value & (LONG_MAX >> 2));
+}
+
+#else
+
+long common_dylan_counter_read(int number)
+{
+  return -1;
+}
+
+#endif
@@ -0,0 +1,45 @@
+#include <stdio.h>
+
+/* The C baselines for io-format-benchmark: sprintf COUNT integers from
+   START, or those integers divided by seven as doubles, into a reused
+   buffer, separated by spaces, and return the number of characters
+   written.  %.17g is the shortest sprintf format that always round
+   trips, so it's the one to compare shortest float printing with. */
+
+long io_format_benchmark_sprintf(long start, long count)
+{
+  char buffer[65536];
+  size_t used = 0;
+  long total = 0;
+  long i;
+
+  for (i = start; i < start + count; i++) {
+    int n;
+    if (used > sizeof(buffer) - 32) {
+      used = 0;
+    }
+    n = sprintf(buffer + used, "%ld ", i);
+    used += n;
+    total += n;
+  }
+  return total;
+}
+
+long io_format_benchmark_sprintf_doubles(long start, long count)
+{
+  char buffer[65536];
+  size_t used = 0;
+  long total = 0;
+  long i;
+
+  for (i = start; i < start + count; i++) {
+    int n;
+    if (used > sizeof(buffer) - 32) {
+      used = 0;
+    }
+    n = sprintf(buffer + used, "%.17g ", (double)i / 7.0);
+    used += n;
+    total += n;
+  }
+  return total;
+}
@@ -480,35 +480,42 @@ DMINT primitive_machine_word_double_divide(DMINT xl, DMINT xh, DMINT y) {
 }
 
 #ifndef OPEN_DYLAN_COMPILER_GCC_LIKE
-DMINT primitive_machine_word_count_low_zeros(DMINT x) {
-  if (x == 0) return(DMINT)(primitive_word_size() * 8);
-  DMINT mask4 = (DMINT)0xF;
-  int index = (int)(mask4 & x);
-  int count = 0;
-  static int t[16] = { 4, 0, 1, 0, 2, 0, 1, 0, 3, 0, 1, 0, 2, 0, 1, 0 };
+/* Portable versions of the bit counting primitives for compilers
+   without __builtin_popcount and friends.  They are branch free apart
+   from the zero checks, since bit-vector and bit-set operations call
+   them once per word. */
 
-  /* scan for a non-zero low nibble. */
-  for (; index == 0; count += 4, x >>= 4, index = (int)(mask4 & x)) {}
-  return(DMINT)(count + t[index]);
+DMINT primitive_machine_word_count_ones(DMINT x) {
+  DUMINT ux = (DUMINT)x;
+  DUMINT m1 = ~(DUMINT)0 / 3;        /* 0x5555... */
+  DUMINT m2 = ~(DUMINT)0 / 5;        /* 0x3333... */
+  DUMINT m4 = ~(DUMINT)0 / 17;       /* 0x0F0F... */
+  DUMINT h01 = ~(DUMINT)0 / 255;     /* 0x0101... */
+  ux = ux - ((ux >> 1) & m1);
+  ux = (ux & m2) + ((ux >> 2) & m2);
+  ux = (ux + (ux >> 4)) & m4;
+  return(DMINT)((ux * h01) >> (primitive_word_size() * 8 - 8));
 }
 
-DMINT primitive_machine_word_count_high_zeros(DMINT x) {
-  if (x == 0) return(DMINT)(primitive_word_size() * 8);
+DMINT primitive_machine_word_count_low_zeros(DMINT x) {
   DUMINT ux = (DUMINT)x;
-  DUMINT mask4 = ((DUMINT)0xF) << (primitive_word_size() * 8 - 4);
-  DUMINT uindex = mask4 & ux;
-  int count = 0;
-  static int t[16] = { 4, 3, 2, 2, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0 };
-
-  /* scan for non-zero high nibble. */
-  for (; uindex == (DUMINT)0; count += 4, ux <<= 4, uindex = mask4 & ux) {}
-  int index = (int)(uindex >> (primitive_word_size() * 8 - 4));
-  return(DMINT)(count + t[index]);
+  if (ux == 0) return(DMINT)(primitive_word_size() * 8);
+  /* The ones below the lowest set bit. */
+  return primitive_machine_word_count_ones((DMINT)((ux & (0 - ux)) - 1));
 }
 
-DMINT primitive_machine_word_count_ones(DMINT x) {
-# error primitive_machine_word_count_ones not implemented
-  return 0;
+DMINT primitive_machine_word_count_high_zeros(DMINT x) {
+  DUMINT ux = (DUMINT)x;
+  if (ux == 0) return(DMINT)(primitive_word_size() * 8);
+  /* Smear the highest set bit downwards and count what's left above. */
+  ux |= ux >> 1;
+  ux |= ux >> 2;
+  ux |= ux >> 4;
+  ux |= ux >> 8;
+  ux |= ux >> 16;
+  ux |= (ux >> 16) >> 16;        /* no-op for 32-bit words */
+  return(DMINT)(primitive_word_size() * 8)
+           - primitive_machine_word_count_ones((DMINT)ux);
 }
 #endif
 
@@ -1367,6 +1367,129 @@ dylan_value primitive_set_accessor_method_xep (dylan_value accmeth, dylan_value
 
 /* KEYWORD PROCESSING SUPPORT */
 
+/* Matching supplied keywords against the specifiers of a function that
+ * takes many of them, like make, is slow as a nested linear scan.  For
+ * those, a hash table from keyword to position is built the first time
+ * the specifier vector is used, and kept in a 2-way set-associative cache
+ * keyed by the vector's address.  Tables are never evicted: when both
+ * ways of a set are taken by other vectors, the caller falls back to the
+ * linear scan rather than building a table on every call, so the cache
+ * never holds more than KEYWORD_TABLE_CACHE_SETS * KEYWORD_TABLE_CACHE_WAYS
+ * tables.  Tables live in the Dylan heap and the cache is registered as
+ * a root by _Init_Run_Time, so a cached table and the vector it refers
+ * to are never reclaimed, and the vector's address is never reused.
+ * Specifier vectors are literals, so that pins nothing that would
+ * otherwise go.  Keys and the tables' own hashing use addresses, which
+ * is only sound because the collectors the C run-time supports never
+ * move objects.  A table is immutable once published, so threads share
+ * them without locking.
+ */
+
+#if !defined(GC_USE_BOEHM) && !defined(GC_USE_MALLOC)
+#error The keyword table cache needs a collector that never moves objects
+#endif
+
+#define KEYWORD_TABLE_MIN_KEYWORDS 8
+#define KEYWORD_TABLE_CACHE_SETS   128
+#define KEYWORD_TABLE_CACHE_WAYS   2
+
+typedef struct keyword_table_entry {
+  dylan_value keyword;
+  DSINT       index;
+} KEYWORD_TABLE_ENTRY;
+
+typedef struct keyword_table {
+  dylan_simple_object_vector* specifiers;
+  DSINT                       skip;
+  DUMINT                      mask;
+  KEYWORD_TABLE_ENTRY         entries[];
+} KEYWORD_TABLE;
+
+static KEYWORD_TABLE* keyword_tables[KEYWORD_TABLE_CACHE_SETS][KEYWORD_TABLE_CACHE_WAYS];
+
+static inline DUMINT keyword_table_hash (dylan_value object) {
+  DUMINT h = ((DUMINT)object >> 3) * 2654435761u;
+  return(h ^ (h >> 16));
+}
+
+static KEYWORD_TABLE* make_keyword_table
+    (dylan_simple_object_vector* specifiers, int skip) {
+  dylan_value* data = vector_data(specifiers);
+  int number_keywords = vector_size(specifiers) / skip;
+  DUMINT capacity = 2 * KEYWORD_TABLE_MIN_KEYWORDS;
+  while (capacity < 2 * (DUMINT)number_keywords) {
+    capacity *= 2;
+  }
+  size_t size = sizeof(KEYWORD_TABLE) + capacity * sizeof(KEYWORD_TABLE_ENTRY);
+  KEYWORD_TABLE* table = (KEYWORD_TABLE*)
+    primitive_allocate((size + sizeof(dylan_value) - 1) / sizeof(dylan_value));
+  table->specifiers = specifiers;
+  table->skip = skip;
+  table->mask = capacity - 1;
+  for (DUMINT i = 0; i < capacity; i++) {
+    table->entries[i].keyword = NULL;
+  }
+  /* Keep the first of any duplicated keyword, as the linear scan does. */
+  for (int i = 0; i < number_keywords; i++) {
+    dylan_value keyword = data[i * skip];
+    DUMINT probe = keyword_table_hash(keyword) & table->mask;
+    while (table->entries[probe].keyword != NULL
+           && table->entries[probe].keyword != keyword) {
+      probe = (probe + 1) & table->mask;
+    }
+    if (table->entries[probe].keyword == NULL) {
+      table->entries[probe].keyword = keyword;
+      table->entries[probe].index = i;
+    }
+  }
+  return(table);
+}
+
+/* The table for SPECIFIERS, whose keywords are every SKIP elements, or
+   NULL if it has too few keywords to be worth one or its set is full. */
+static KEYWORD_TABLE* keyword_table
+    (dylan_simple_object_vector* specifiers, int skip) {
+  if (vector_size(specifiers) < KEYWORD_TABLE_MIN_KEYWORDS * skip) {
+    return(NULL);
+  }
+  KEYWORD_TABLE** set
+    = keyword_tables[keyword_table_hash(specifiers) % KEYWORD_TABLE_CACHE_SETS];
+  KEYWORD_TABLE* table = NULL;
+  for (int way = 0; way < KEYWORD_TABLE_CACHE_WAYS; way++) {
+    KEYWORD_TABLE* entry = __atomic_load_n(&set[way], __ATOMIC_ACQUIRE);
+    while (entry == NULL) {
+      /* An empty way: claim it.  If another thread gets there first,
+         look at what it published instead. */
+      if (table == NULL) {
+        table = make_keyword_table(specifiers, skip);
+      }
+      if (__atomic_compare_exchange_n(&set[way], &entry, table, 0,
+                                      __ATOMIC_RELEASE, __ATOMIC_ACQUIRE)) {
+        return(table);
+      }
+    }
+    if (entry->specifiers == specifiers && entry->skip == skip) {
+      return(entry);
+    }
+  }
+  /* Built for a lost race, this still serves the current call. */
+  return(table);
+}
+
+/* The position of KEYWORD among the table's keywords, or -1. */
+static inline DSINT keyword_table_lookup (KEYWORD_TABLE* table, dylan_value keyword) {
+  DUMINT probe = keyword_table_hash(keyword) & table->mask;
+  for (;;) {
+    dylan_value entry = table->entries[probe].keyword;
+    if (entry == keyword) {
+      return(table->entries[probe].index);
+    } else if (entry == NULL) {
+      return(-1);
+    }
+    probe = (probe + 1) & table->mask;
+  }
+}
+
 INLINE void default_arguments
     (int number_required, dylan_value* arguments,
      int number_keywords, dylan_value* keyword_specifiers,
@@ -1388,11 +1511,22 @@ INLINE void default_arguments
 
 INLINE void process_keyword_parameters
     (dylan_simple_method* function, int number_required,
-     int number_keywords, dylan_value keyword_specifiers[],
+     int number_keywords, dylan_value keyword_specifiers[], KEYWORD_TABLE* table,
      int number_optionals, dylan_value optional_arguments[], dylan_value new_arguments[]) {
   int i,j,k;
   int size_keyword_specifiers = number_keywords * 2;
   ignore(function);
+  if (table != NULL) {
+    for (i = number_optionals - 1; i >= 0;) {
+      dylan_value value   = optional_arguments[i--];
+      dylan_value keyword = optional_arguments[i--];
+      DSINT index = keyword_table_lookup(table, keyword);
+      if (index >= 0) {
+        new_arguments[number_required + 1 + index] = value;
+      }
+    }
+    return;
+  }
   for (i = number_optionals - 1; i >= 0;) {
     dylan_value value   = optional_arguments[i--];
     dylan_value keyword = optional_arguments[i--];
@@ -1422,7 +1556,7 @@ INLINE int process_keyword_call_into
                     keyword_specifiers, number_required + 1, new_arguments);
   process_keyword_parameters
     (function, number_required, number_keywords, keyword_specifiers,
-     optionals_count, optional_arguments, new_arguments);
+     keyword_table(keyword_specifier_vector, 2), optionals_count, optional_arguments, new_arguments);
 
   new_arguments[number_required] = rest_arguments;
   return(new_argument_count);
@@ -2175,6 +2309,109 @@ dylan_value raw_byte_repeated_instance_slot_setter_engine (dylan_value newval, d
   }
 }
 
+/* Raw repeated slots keep their elements unboxed from the slot at the
+   engine's index onward.  A new value of the wrong type goes to the
+   Dylan callback, which signals the type error. */
+
+extern Wrapper KLmachine_wordGVKeW;
+extern Wrapper KLdouble_floatGVKdW;
+
+#define RAW_ELEMENTS(type, object, baseidx) \
+  ((type*)&((((dylan_object*)(object))->slots)[baseidx]))
+
+dylan_value raw_word_repeated_instance_slot_getter_engine (dylan_value object, dylan_value idx) {
+  TEB* teb = get_teb();
+  ENGINE* e = (ENGINE*)teb->function;
+  int baseidx = (int)(((DADDR)(e->properties)) >> SLOTENGINE_V_INDEX);
+  int size = primitive_repeated_instance_size(object, baseidx);
+  int ridx = R(idx);
+  if (ridx >= 0 && ridx < size) {
+    return(primitive_wrap_machine_word(RAW_ELEMENTS(DMINT, object, baseidx)[ridx]));
+  } else {
+    return(REPEATED_GETTER_OOR(object, idx));
+  }
+}
+
+dylan_value raw_word_repeated_instance_slot_setter_engine (dylan_value newval, dylan_value object, dylan_value idx) {
+  TEB* teb = get_teb();
+  ENGINE* e = (ENGINE*)teb->function;
+  if (TAGGEDQ(newval) || OBJECT_WRAPPER(newval) != &KLmachine_wordGVKeW) {
+    return(general_engine_node_3_engine(newval, object, idx));
+  }
+  int baseidx = (int)(((DADDR)(e->properties)) >> SLOTENGINE_V_INDEX);
+  int size = primitive_repeated_instance_size(object, baseidx);
+  int ridx = R(idx);
+  if (ridx >= 0 && ridx < size) {
+    RAW_ELEMENTS(DMINT, object, baseidx)[ridx] = primitive_unwrap_machine_word(newval);
+    return(newval);
+  } else {
+    return(REPEATED_SETTER_OOR(newval, object, idx));
+  }
+}
+
+dylan_value raw_double_float_repeated_instance_slot_getter_engine (dylan_value object, dylan_value idx) {
+  TEB* teb = get_teb();
+  ENGINE* e = (ENGINE*)teb->function;
+  int baseidx = (int)(((DADDR)(e->properties)) >> SLOTENGINE_V_INDEX);
+  int size = primitive_repeated_instance_size(object, baseidx);
+  int ridx = R(idx);
+  if (ridx >= 0 && ridx < size) {
+    return(primitive_raw_as_double_float(RAW_ELEMENTS(DDFLT, object, baseidx)[ridx]));
+  } else {
+    return(REPEATED_GETTER_OOR(object, idx));
+  }
+}
+
+dylan_value raw_double_float_repeated_instance_slot_setter_engine (dylan_value newval, dylan_value object, dylan_value idx) {
+  TEB* teb = get_teb();
+  ENGINE* e = (ENGINE*)teb->function;
+  if (TAGGEDQ(newval) || OBJECT_WRAPPER(newval) != &KLdouble_floatGVKdW) {
+    return(general_engine_node_3_engine(newval, object, idx));
+  }
+  int baseidx = (int)(((DADDR)(e->properties)) >> SLOTENGINE_V_INDEX);
+  int size = primitive_repeated_instance_size(object, baseidx);
+  int ridx = R(idx);
+  if (ridx >= 0 && ridx < size) {
+    RAW_ELEMENTS(DDFLT, object, baseidx)[ridx] = primitive_double_float_as_raw(newval);
+    return(newval);
+  } else {
+    return(REPEATED_SETTER_OOR(newval, object, idx));
+  }
+}
+
+
+/* Class and each-subclass slots live in a cell, a <pair> whose head is
+   the value, in the class-slot-storage of the object's current
+   implementation class. */
+
+extern dylan_value Kunbound_class_slotVKeI(dylan_value obj, dylan_value offset);
+#define UNBOUND_CLASS_SLOT Kunbound_class_slotVKeI
+
+static inline dylan_value class_slot_cell (dylan_value object, int idx) {
+  dylan_implementation_class* iclass = CLASS_ICLASS(OBJECT_CLASS(object));
+  return(vector_ref((dylan_simple_object_vector*)ICLASS_CLASS_SLOT_STORAGE(iclass), idx));
+}
+
+dylan_value boxed_class_slot_getter_engine (dylan_value object) {
+  TEB* teb = get_teb();
+  ENGINE* e = (ENGINE*)teb->function;
+  int idx = (int)(((DADDR)(e->properties)) >> SLOTENGINE_V_INDEX);
+  dylan_value slot_value = primitive_initialized_slot_value(class_slot_cell(object, idx), 0);
+  if (UNBOUND_P(slot_value)) {
+    return(UNBOUND_CLASS_SLOT(object, I(idx)));
+  } else {
+    return(slot_value);
+  }
+}
+
+dylan_value boxed_class_slot_setter_engine (dylan_value newval, dylan_value object) {
+  TEB* teb = get_teb();
+  ENGINE* e = (ENGINE*)teb->function;
+  int idx = (int)(((DADDR)(e->properties)) >> SLOTENGINE_V_INDEX);
+  primitive_slot_value_setter(newval, class_slot_cell(object, idx), 0);
+  return(newval);
+}
+
 
 
 
@@ -2335,6 +2572,15 @@ dylan_value check_explicit_kwds (dylan_simple_object_vector* optionals, dylan_si
   } else {
     int i;
     int j;
+    KEYWORD_TABLE* table = optsize > 0 ? keyword_table(kwds, kwdskip) : NULL;
+    if (table != NULL) {
+      for (i=0; i<optsize; i+=2) {
+        if (keyword_table_lookup(table, optdata[i]) < 0) {
+          return(optdata[i]);
+        }
+      }
+      return(NULL);
+    }
     for (i=0; i<optsize; i+=2) {
       dylan_value kwdarg = optdata[i];
       for (j=0; j<kwdsize; j+=kwdskip) {
@@ -2728,22 +2974,32 @@ dylan_value primitive_initialize_engine_node (dylan_value engine) {
   case ENGINE_raw_byte_repeated_instance_slot_setter:
     eng->entry_point = (DLFN)raw_byte_repeated_instance_slot_setter_engine;
     break;
+  case ENGINE_raw_word_repeated_instance_slot_getter:
+    eng->entry_point = (DLFN)raw_word_repeated_instance_slot_getter_engine;
+    break;
+  case ENGINE_raw_word_repeated_instance_slot_setter:
+    eng->entry_point = (DLFN)raw_word_repeated_instance_slot_setter_engine;
+    break;
+  case ENGINE_raw_double_float_repeated_instance_slot_getter:
+    eng->entry_point = (DLFN)raw_double_float_repeated_instance_slot_getter_engine;
+    break;
+  case ENGINE_raw_double_float_repeated_instance_slot_setter:
+    eng->entry_point = (DLFN)raw_double_float_repeated_instance_slot_setter_engine;
+    break;
   case ENGINE_boxed_class_slot_getter:
+    eng->entry_point = (DLFN)boxed_class_slot_getter_engine;
+    break;
+  case ENGINE_boxed_class_slot_setter:
+    eng->entry_point = (DLFN)boxed_class_slot_setter_engine;
+    break;
   case ENGINE_reserved_slot_a_getter:
   case ENGINE_reserved_slot_b_getter:
     eng->entry_point = (DLFN)general_engine_node_1_engine;
     break;
   case ENGINE_reserved_slot_a_setter:
   case ENGINE_reserved_slot_b_setter:
-  case ENGINE_boxed_class_slot_setter:
-  case ENGINE_reserved_repeated_slot_a_getter:
-  case ENGINE_reserved_repeated_slot_b_getter:
     eng->entry_point = (DLFN)general_engine_node_2_engine;
     break;
-  case ENGINE_reserved_repeated_slot_a_setter:
-  case ENGINE_reserved_repeated_slot_b_setter:
-    eng->entry_point = (DLFN)general_engine_node_3_engine;
-    break;
   default:
     /* FMH */
     ;
@@ -3301,6 +3557,14 @@ dylan_value MV_SPILL (dylan_value first_value) {
   return (dylan_value) dest;
 }
 
+dylan_value MV_SPILL_INTO (dylan_value first_value, MV *dest, int capacity) {
+  TEB* teb = get_teb();
+  if (teb->return_values.count > capacity) {
+    return MV_SPILL(first_value);
+  }
+  return MV_SPILL_into(first_value, dest);
+}
+
 dylan_value MV_UNSPILL (dylan_value spill_t) {
   TEB* teb = get_teb();
   MV *src = (MV *) spill_t;
@@ -3417,6 +3681,45 @@ dylan_value MAKE_CLOSURE_INITD_SIG (dylan_value schema, dylan_value sig, int clo
   return((dylan_value)fn);
 }
 
+/* Storage from the caller's frame isn't zeroed as the heap is, so the
+   environment of a closure that is initialized later is cleared here. */
+
+INLINE dylan_simple_closure_method* closure_in
+    (void* storage, dylan_value schema, int closure_size) {
+  memset(storage, 0, CLOSURE_BYTES(closure_size));
+  memcpy(storage, schema, sizeof(dylan_simple_closure_method));
+  return((dylan_simple_closure_method*)storage);
+}
+
+dylan_value MAKE_CLOSURE_IN (void* storage, dylan_value schema, int closure_size) {
+  return((dylan_value)closure_in(storage, schema, closure_size));
+}
+
+dylan_value MAKE_CLOSURE_SIG_IN (void* storage, dylan_value schema, dylan_value sig, int closure_size) {
+  dylan_simple_closure_method* fn = closure_in(storage, schema, closure_size);
+  fn->signature = sig;
+  return((dylan_value)fn);
+}
+
+dylan_value MAKE_CLOSURE_INITD_IN (void* storage, dylan_value schema, int closure_size, ...) {
+  TEB* teb = get_teb();
+  dylan_simple_closure_method* fn = (dylan_simple_closure_method*)storage;
+  memcpy(fn, schema, sizeof(dylan_simple_closure_method));
+  BUFFER_VARARGS(closure_size, closure_size, teb->buffer);
+  init_environment(fn, closure_size, teb->buffer);
+  return((dylan_value)fn);
+}
+
+dylan_value MAKE_CLOSURE_INITD_SIG_IN (void* storage, dylan_value schema, dylan_value sig, int closure_size, ...) {
+  TEB* teb = get_teb();
+  dylan_simple_closure_method* fn = (dylan_simple_closure_method*)storage;
+  memcpy(fn, schema, sizeof(dylan_simple_closure_method));
+  fn->signature = sig;
+  BUFFER_VARARGS(closure_size, closure_size, teb->buffer);
+  init_environment(fn, closure_size, teb->buffer);
+  return((dylan_value)fn);
+}
+
 dylan_value MAKE_METHOD_SIG (dylan_value schema, dylan_value sig) {
   dylan_simple_closure_method* fn = (dylan_simple_closure_method*)allocate(sizeof(dylan_simple_closure_method));
   memcpy(fn, schema, sizeof(dylan_simple_closure_method));
@@ -3476,6 +3779,42 @@ dylan_value MAKE_KEYWORD_CLOSURE_INITD_SIG (dylan_value schema, dylan_value sig,
   return((dylan_value)fn);
 }
 
+INLINE dylan_keyword_closure_method* keyword_closure_in
+    (void* storage, dylan_value schema, int closure_size) {
+  memset(storage, 0, KEYWORD_CLOSURE_BYTES(closure_size));
+  memcpy(storage, schema, sizeof(dylan_keyword_closure_method));
+  return((dylan_keyword_closure_method*)storage);
+}
+
+dylan_value MAKE_KEYWORD_CLOSURE_IN (void* storage, dylan_value schema, int closure_size) {
+  return((dylan_value)keyword_closure_in(storage, schema, closure_size));
+}
+
+dylan_value MAKE_KEYWORD_CLOSURE_SIG_IN (void* storage, dylan_value schema, dylan_value sig, int closure_size) {
+  dylan_keyword_closure_method* fn = keyword_closure_in(storage, schema, closure_size);
+  fn->signature = sig;
+  return((dylan_value)fn);
+}
+
+dylan_value MAKE_KEYWORD_CLOSURE_INITD_IN (void* storage, dylan_value schema, int closure_size, ...) {
+  TEB* teb = get_teb();
+  dylan_keyword_closure_method* fn = (dylan_keyword_closure_method*)storage;
+  memcpy(fn, schema, sizeof(dylan_keyword_closure_method));
+  BUFFER_VARARGS(closure_size, closure_size, teb->buffer);
+  init_keyword_environment(fn, closure_size, teb->buffer);
+  return((dylan_value)fn);
+}
+
+dylan_value MAKE_KEYWORD_CLOSURE_INITD_SIG_IN (void* storage, dylan_value schema, dylan_value sig, int closure_size, ...) {
+  TEB* teb = get_teb();
+  dylan_keyword_closure_method* fn = (dylan_keyword_closure_method*)storage;
+  memcpy(fn, schema, sizeof(dylan_keyword_closure_method));
+  fn->signature = sig;
+  BUFFER_VARARGS(closure_size, closure_size, teb->buffer);
+  init_keyword_environment(fn, closure_size, teb->buffer);
+  return((dylan_value)fn);
+}
+
 dylan_value MAKE_KEYWORD_METHOD_SIG (dylan_value schema, dylan_value sig) {
   dylan_keyword_method* fn = (dylan_keyword_method*)allocate(sizeof(dylan_keyword_method));
   memcpy(fn, schema, sizeof(dylan_keyword_method));
@@ -3740,6 +4079,9 @@ void _Init_Run_Time ()
 
 #ifdef GC_USE_BOEHM
     GC_INIT();
+    // The cache is all that keeps its keyword tables alive.
+    GC_add_roots((char *)keyword_tables,
+                 (char *)keyword_tables + sizeof(keyword_tables));
 #endif
 
     initialize_threads_primitives();
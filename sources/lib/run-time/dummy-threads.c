@@ -168,6 +168,16 @@ void primitive_thread_yield() {
 void primitive_sleep(dylan_value ms) {
   ignore(ms);
 }
+void primitive_start_lock_profiling() {
+}
+void primitive_stop_lock_profiling() {
+}
+void primitive_dump_lock_profile() {
+}
+dylan_value primitive_lock_contention_count(dylan_value n) {
+  ignore(n);
+  return(I(0));
+}
 dylan_value primitive_make_simple_lock(dylan_value l, dylan_value n) {
   ignore(l); ignore(n);
   return(THREAD_SUCCESS);
@@ -0,0 +1,636 @@
+#include "float-format.h"
+
+#include <string.h>
+
+#if defined(OPEN_DYLAN_PLATFORM_WINDOWS)
+typedef unsigned __int32 uint32_t;
+typedef unsigned __int64 uint64_t;
+#define UINT64_C(c) c ## ui64
+#else
+#include <stdint.h>
+#endif
+
+/* A double's digits: the value is 0.DIGITS * 10^POINT. */
+#define SHORTEST_DIGITS_SIZE 24
+
+#define DOUBLE_HIDDEN_BIT        (UINT64_C(1) << 52)
+#define DOUBLE_FRACTION_MASK     (DOUBLE_HIDDEN_BIT - 1)
+#define DOUBLE_EXPONENT_BIAS     (0x3FF + 52)
+#define DOUBLE_DENORMAL_EXPONENT (1 - DOUBLE_EXPONENT_BIAS)
+
+static int double_biased_exponent(uint64_t bits)
+{
+  return (int)((bits >> 52) & 0x7FF);
+}
+
+/* A double's neighbours are equally far away either side of it, except
+ * at a power of two, where the one below is half as far. */
+static int double_lower_boundary_closer(uint64_t bits)
+{
+  return (bits & DOUBLE_FRACTION_MASK) == 0 && double_biased_exponent(bits) > 1;
+}
+
+
+/// Grisu3
+
+/* F * 2^E, with a 64-bit F. */
+typedef struct diy_fp {
+  uint64_t f;
+  int e;
+} DIY_FP;
+
+static DIY_FP double_diy_fp(uint64_t bits)
+{
+  DIY_FP x;
+  int biased_exponent = double_biased_exponent(bits);
+  if (biased_exponent == 0) {
+    x.f = bits & DOUBLE_FRACTION_MASK;
+    x.e = DOUBLE_DENORMAL_EXPONENT;
+  } else {
+    x.f = (bits & DOUBLE_FRACTION_MASK) + DOUBLE_HIDDEN_BIT;
+    x.e = biased_exponent - DOUBLE_EXPONENT_BIAS;
+  }
+  return x;
+}
+
+static DIY_FP diy_fp_normalize(DIY_FP x)
+{
+  while ((x.f & (UINT64_C(0xFFC0) << 48)) == 0) {
+    x.f <<= 10;
+    x.e -= 10;
+  }
+  while ((x.f & (UINT64_C(1) << 63)) == 0) {
+    x.f <<= 1;
+    x.e -= 1;
+  }
+  return x;
+}
+
+/* The high 64 bits of the product, rounded. */
+static DIY_FP diy_fp_times(DIY_FP x, DIY_FP y)
+{
+  const uint64_t mask_32 = 0xFFFFFFFF;
+  uint64_t a = x.f >> 32, b = x.f & mask_32;
+  uint64_t c = y.f >> 32, d = y.f & mask_32;
+  uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+  uint64_t middle = (bd >> 32) + (ad & mask_32) + (bc & mask_32) + (UINT64_C(1) << 31);
+  DIY_FP product;
+  product.f = ac + (ad >> 32) + (bc >> 32) + (middle >> 32);
+  product.e = x.e + y.e + 64;
+  return product;
+}
+
+/* The midpoints between BITS and its neighbours, normalized to the same
+ * exponent. */
+static void double_boundaries(uint64_t bits, DIY_FP *minus, DIY_FP *plus)
+{
+  DIY_FP v = double_diy_fp(bits), m_plus, m_minus;
+  m_plus.f = (v.f << 1) + 1;
+  m_plus.e = v.e - 1;
+  m_plus = diy_fp_normalize(m_plus);
+  if (double_lower_boundary_closer(bits)) {
+    m_minus.f = (v.f << 2) - 1;
+    m_minus.e = v.e - 2;
+  } else {
+    m_minus.f = (v.f << 1) - 1;
+    m_minus.e = v.e - 1;
+  }
+  m_minus.f <<= m_minus.e - m_plus.e;
+  m_minus.e = m_plus.e;
+  *minus = m_minus;
+  *plus = m_plus;
+}
+
+/* Normalized 10^decimal_exponent, rounded, every eighth power of ten. */
+typedef struct cached_power {
+  uint64_t significand;
+  int binary_exponent;
+  int decimal_exponent;
+} CACHED_POWER;
+
+static const CACHED_POWER cached_powers[] = {
+  { UINT64_C(0xfa8fd5a0081c0288), -1220, -348 },
+  { UINT64_C(0xbaaee17fa23ebf76), -1193, -340 },
+  { UINT64_C(0x8b16fb203055ac76), -1166, -332 },
+  { UINT64_C(0xcf42894a5dce35ea), -1140, -324 },
+  { UINT64_C(0x9a6bb0aa55653b2d), -1113, -316 },
+  { UINT64_C(0xe61acf033d1a45df), -1087, -308 },
+  { UINT64_C(0xab70fe17c79ac6ca), -1060, -300 },
+  { UINT64_C(0xff77b1fcbebcdc4f), -1034, -292 },
+  { UINT64_C(0xbe5691ef416bd60c), -1007, -284 },
+  { UINT64_C(0x8dd01fad907ffc3c),  -980, -276 },
+  { UINT64_C(0xd3515c2831559a83),  -954, -268 },
+  { UINT64_C(0x9d71ac8fada6c9b5),  -927, -260 },
+  { UINT64_C(0xea9c227723ee8bcb),  -901, -252 },
+  { UINT64_C(0xaecc49914078536d),  -874, -244 },
+  { UINT64_C(0x823c12795db6ce57),  -847, -236 },
+  { UINT64_C(0xc21094364dfb5637),  -821, -228 },
+  { UINT64_C(0x9096ea6f3848984f),  -794, -220 },
+  { UINT64_C(0xd77485cb25823ac7),  -768, -212 },
+  { UINT64_C(0xa086cfcd97bf97f4),  -741, -204 },
+  { UINT64_C(0xef340a98172aace5),  -715, -196 },
+  { UINT64_C(0xb23867fb2a35b28e),  -688, -188 },
+  { UINT64_C(0x84c8d4dfd2c63f3b),  -661, -180 },
+  { UINT64_C(0xc5dd44271ad3cdba),  -635, -172 },
+  { UINT64_C(0x936b9fcebb25c996),  -608, -164 },
+  { UINT64_C(0xdbac6c247d62a584),  -582, -156 },
+  { UINT64_C(0xa3ab66580d5fdaf6),  -555, -148 },
+  { UINT64_C(0xf3e2f893dec3f126),  -529, -140 },
+  { UINT64_C(0xb5b5ada8aaff80b8),  -502, -132 },
+  { UINT64_C(0x87625f056c7c4a8b),  -475, -124 },
+  { UINT64_C(0xc9bcff6034c13053),  -449, -116 },
+  { UINT64_C(0x964e858c91ba2655),  -422, -108 },
+  { UINT64_C(0xdff9772470297ebd),  -396, -100 },
+  { UINT64_C(0xa6dfbd9fb8e5b88f),  -369,  -92 },
+  { UINT64_C(0xf8a95fcf88747d94),  -343,  -84 },
+  { UINT64_C(0xb94470938fa89bcf),  -316,  -76 },
+  { UINT64_C(0x8a08f0f8bf0f156b),  -289,  -68 },
+  { UINT64_C(0xcdb02555653131b6),  -263,  -60 },
+  { UINT64_C(0x993fe2c6d07b7fac),  -236,  -52 },
+  { UINT64_C(0xe45c10c42a2b3b06),  -210,  -44 },
+  { UINT64_C(0xaa242499697392d3),  -183,  -36 },
+  { UINT64_C(0xfd87b5f28300ca0e),  -157,  -28 },
+  { UINT64_C(0xbce5086492111aeb),  -130,  -20 },
+  { UINT64_C(0x8cbccc096f5088cc),  -103,  -12 },
+  { UINT64_C(0xd1b71758e219652c),   -77,   -4 },
+  { UINT64_C(0x9c40000000000000),   -50,    4 },
+  { UINT64_C(0xe8d4a51000000000),   -24,   12 },
+  { UINT64_C(0xad78ebc5ac620000),     3,   20 },
+  { UINT64_C(0x813f3978f8940984),    30,   28 },
+  { UINT64_C(0xc097ce7bc90715b3),    56,   36 },
+  { UINT64_C(0x8f7e32ce7bea5c70),    83,   44 },
+  { UINT64_C(0xd5d238a4abe98068),   109,   52 },
+  { UINT64_C(0x9f4f2726179a2245),   136,   60 },
+  { UINT64_C(0xed63a231d4c4fb27),   162,   68 },
+  { UINT64_C(0xb0de65388cc8ada8),   189,   76 },
+  { UINT64_C(0x83c7088e1aab65db),   216,   84 },
+  { UINT64_C(0xc45d1df942711d9a),   242,   92 },
+  { UINT64_C(0x924d692ca61be758),   269,  100 },
+  { UINT64_C(0xda01ee641a708dea),   295,  108 },
+  { UINT64_C(0xa26da3999aef774a),   322,  116 },
+  { UINT64_C(0xf209787bb47d6b85),   348,  124 },
+  { UINT64_C(0xb454e4a179dd1877),   375,  132 },
+  { UINT64_C(0x865b86925b9bc5c2),   402,  140 },
+  { UINT64_C(0xc83553c5c8965d3d),   428,  148 },
+  { UINT64_C(0x952ab45cfa97a0b3),   455,  156 },
+  { UINT64_C(0xde469fbd99a05fe3),   481,  164 },
+  { UINT64_C(0xa59bc234db398c25),   508,  172 },
+  { UINT64_C(0xf6c69a72a3989f5c),   534,  180 },
+  { UINT64_C(0xb7dcbf5354e9bece),   561,  188 },
+  { UINT64_C(0x88fcf317f22241e2),   588,  196 },
+  { UINT64_C(0xcc20ce9bd35c78a5),   614,  204 },
+  { UINT64_C(0x98165af37b2153df),   641,  212 },
+  { UINT64_C(0xe2a0b5dc971f303a),   667,  220 },
+  { UINT64_C(0xa8d9d1535ce3b396),   694,  228 },
+  { UINT64_C(0xfb9b7cd9a4a7443c),   720,  236 },
+  { UINT64_C(0xbb764c4ca7a44410),   747,  244 },
+  { UINT64_C(0x8bab8eefb6409c1a),   774,  252 },
+  { UINT64_C(0xd01fef10a657842c),   800,  260 },
+  { UINT64_C(0x9b10a4e5e9913129),   827,  268 },
+  { UINT64_C(0xe7109bfba19c0c9d),   853,  276 },
+  { UINT64_C(0xac2820d9623bf429),   880,  284 },
+  { UINT64_C(0x80444b5e7aa7cf85),   907,  292 },
+  { UINT64_C(0xbf21e44003acdd2d),   933,  300 },
+  { UINT64_C(0x8e679c2f5e44ff8f),   960,  308 },
+  { UINT64_C(0xd433179d9c8cb841),   986,  316 },
+  { UINT64_C(0x9e19db92b4e31ba9),  1013,  324 },
+  { UINT64_C(0xeb96bf6ebadf77d9),  1039,  332 },
+  { UINT64_C(0xaf87023b9bf0ee6b),  1066,  340 },
+};
+
+#define CACHED_POWERS_COUNT ((int)(sizeof(cached_powers) / sizeof(cached_powers[0])))
+
+/* Scaled digit generation wants products whose binary exponent is in
+ * this range, so the integral part fits in 32 bits and the fractional
+ * part has room to multiply by ten. */
+#define GRISU_MINIMAL_TARGET_EXPONENT (-60)
+#define GRISU_MAXIMAL_TARGET_EXPONENT (-32)
+
+/* A cached power whose binary exponent is at least MIN_EXPONENT.  The
+ * powers are about 26.6 binary orders apart and the target range is 28
+ * wide, so the first one that's big enough also fits below the top. */
+static const CACHED_POWER *cached_power_for(int min_exponent)
+{
+  int index = (min_exponent - cached_powers[0].binary_exponent) * 10 / 266;
+  if (index < 0) {
+    index = 0;
+  }
+  while (index > 0 && cached_powers[index - 1].binary_exponent >= min_exponent) {
+    index--;
+  }
+  while (index < CACHED_POWERS_COUNT - 1
+         && cached_powers[index].binary_exponent < min_exponent) {
+    index++;
+  }
+  return &cached_powers[index];
+}
+
+/* The largest power of ten not above NUMBER, which is not zero, and how
+ * many digits NUMBER has. */
+static uint32_t biggest_power_ten(uint32_t number, int *digit_count)
+{
+  uint32_t power = 1;
+  int count = 1;
+  while (power <= number / 10) {
+    power *= 10;
+    count++;
+  }
+  *digit_count = count;
+  return power;
+}
+
+/* Moves the last digit towards W while the result stays safely inside
+ * the interval, then checks that the answer is unambiguous.  The
+ * distances are all scaled by the same power of two; UNIT is the error
+ * of the scaled values. */
+static int grisu_round_weed(char *digits, int length,
+                            uint64_t distance_too_high_w,
+                            uint64_t unsafe_interval, uint64_t rest,
+                            uint64_t ten_kappa, uint64_t unit)
+{
+  uint64_t small_distance = distance_too_high_w - unit;
+  uint64_t big_distance = distance_too_high_w + unit;
+  while (rest < small_distance
+         && unsafe_interval - rest >= ten_kappa
+         && (rest + ten_kappa < small_distance
+             || small_distance - rest >= rest + ten_kappa - small_distance)) {
+    digits[length - 1]--;
+    rest += ten_kappa;
+  }
+  if (rest < big_distance
+      && unsafe_interval - rest >= ten_kappa
+      && (rest + ten_kappa < big_distance
+          || big_distance - rest > rest + ten_kappa - big_distance)) {
+    return 0;
+  }
+  return 2 * unit <= rest && rest <= unsafe_interval - 4 * unit;
+}
+
+/* Generates the shortest digits within (LOW, HIGH), the scaled
+ * boundaries, and nearest to W.  Returns 0 if it can't be sure of the
+ * result. */
+static int grisu_digit_gen(DIY_FP low, DIY_FP w, DIY_FP high,
+                           char *digits, int *length, int *kappa)
+{
+  uint64_t unit = 1;
+  uint64_t too_low = low.f - unit;
+  uint64_t too_high = high.f + unit;
+  uint64_t unsafe_interval = too_high - too_low;
+  int shift = -w.e;
+  uint64_t one = UINT64_C(1) << shift;
+  uint32_t integrals = (uint32_t)(too_high >> shift);
+  uint64_t fractionals = too_high & (one - 1);
+  int digit_count;
+  uint32_t divisor = biggest_power_ten(integrals, &digit_count);
+  *kappa = digit_count;
+  *length = 0;
+  while (*kappa > 0) {
+    digits[(*length)++] = (char)('0' + integrals / divisor);
+    integrals %= divisor;
+    (*kappa)--;
+    uint64_t rest = ((uint64_t)integrals << shift) + fractionals;
+    if (rest < unsafe_interval) {
+      return grisu_round_weed(digits, *length, too_high - w.f,
+                              unsafe_interval, rest,
+                              (uint64_t)divisor << shift, unit);
+    }
+    divisor /= 10;
+  }
+  for (;;) {
+    fractionals *= 10;
+    unit *= 10;
+    unsafe_interval *= 10;
+    digits[(*length)++] = (char)('0' + (int)(fractionals >> shift));
+    fractionals &= one - 1;
+    (*kappa)--;
+    if (fractionals < unsafe_interval) {
+      return grisu_round_weed(digits, *length, (too_high - w.f) * unit,
+                              unsafe_interval, fractionals, one, unit);
+    }
+  }
+}
+
+/* The shortest digits of the positive finite double BITS.  Returns their
+ * number, or 0 if Grisu3 isn't sure of them. */
+static int grisu3(uint64_t bits, char *digits, int *point)
+{
+  DIY_FP w = diy_fp_normalize(double_diy_fp(bits));
+  DIY_FP boundary_minus, boundary_plus;
+  double_boundaries(bits, &boundary_minus, &boundary_plus);
+  const CACHED_POWER *power
+    = cached_power_for(GRISU_MINIMAL_TARGET_EXPONENT - (w.e + 64));
+  DIY_FP ten_mk;
+  ten_mk.f = power->significand;
+  ten_mk.e = power->binary_exponent;
+  int length, kappa;
+  if (!grisu_digit_gen(diy_fp_times(boundary_minus, ten_mk),
+                       diy_fp_times(w, ten_mk),
+                       diy_fp_times(boundary_plus, ten_mk),
+                       digits, &length, &kappa)) {
+    return 0;
+  }
+  *point = length + kappa - power->decimal_exponent;
+  return length;
+}
+
+
+/// Exact digits
+
+/* Enough for any intermediate of the free-format algorithm on doubles,
+ * which stay below 2^1140. */
+#define BIGNUM_WORDS 40
+
+typedef struct bignum {
+  int used;
+  uint32_t words[BIGNUM_WORDS];
+} BIGNUM;
+
+static void bignum_set(BIGNUM *x, uint64_t value)
+{
+  x->used = 0;
+  while (value != 0) {
+    x->words[x->used++] = (uint32_t)value;
+    value >>= 32;
+  }
+}
+
+static void bignum_multiply_small(BIGNUM *x, uint32_t factor)
+{
+  uint64_t carry = 0;
+  int i;
+  for (i = 0; i < x->used; i++) {
+    uint64_t product = (uint64_t)x->words[i] * factor + carry;
+    x->words[i] = (uint32_t)product;
+    carry = product >> 32;
+  }
+  if (carry != 0) {
+    x->words[x->used++] = (uint32_t)carry;
+  }
+}
+
+static void bignum_multiply_power_ten(BIGNUM *x, int exponent)
+{
+  static const uint32_t powers[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000
+  };
+  for (; exponent >= 9; exponent -= 9) {
+    bignum_multiply_small(x, 1000000000);
+  }
+  bignum_multiply_small(x, powers[exponent]);
+}
+
+static void bignum_shift_left(BIGNUM *x, int shift)
+{
+  int words = shift / 32, bits = shift % 32, i;
+  if (x->used == 0) {
+    return;
+  }
+  if (bits != 0) {
+    uint32_t carry = 0;
+    for (i = 0; i < x->used; i++) {
+      uint32_t word = x->words[i];
+      x->words[i] = (word << bits) | carry;
+      carry = word >> (32 - bits);
+    }
+    if (carry != 0) {
+      x->words[x->used++] = carry;
+    }
+  }
+  if (words != 0) {
+    memmove(&x->words[words], &x->words[0], x->used * sizeof(uint32_t));
+    memset(&x->words[0], 0, words * sizeof(uint32_t));
+    x->used += words;
+  }
+}
+
+static int bignum_compare(const BIGNUM *x, const BIGNUM *y)
+{
+  int i;
+  if (x->used != y->used) {
+    return x->used < y->used ? -1 : 1;
+  }
+  for (i = x->used - 1; i >= 0; i--) {
+    if (x->words[i] != y->words[i]) {
+      return x->words[i] < y->words[i] ? -1 : 1;
+    }
+  }
+  return 0;
+}
+
+/* Compares X + Y with Z. */
+static int bignum_plus_compare(const BIGNUM *x, const BIGNUM *y,
+                               const BIGNUM *z)
+{
+  BIGNUM sum;
+  uint64_t carry = 0;
+  int used = x->used > y->used ? x->used : y->used, i;
+  for (i = 0; i < used; i++) {
+    uint64_t word = carry;
+    if (i < x->used) {
+      word += x->words[i];
+    }
+    if (i < y->used) {
+      word += y->words[i];
+    }
+    sum.words[i] = (uint32_t)word;
+    carry = word >> 32;
+  }
+  if (carry != 0) {
+    sum.words[used++] = (uint32_t)carry;
+  }
+  sum.used = used;
+  return bignum_compare(&sum, z);
+}
+
+/* X -= Y, where X >= Y. */
+static void bignum_subtract(BIGNUM *x, const BIGNUM *y)
+{
+  uint64_t borrow = 0;
+  int i;
+  for (i = 0; i < x->used; i++) {
+    uint64_t word = (uint64_t)x->words[i] - borrow;
+    if (i < y->used) {
+      word -= y->words[i];
+    }
+    x->words[i] = (uint32_t)word;
+    borrow = (word >> 32) & 1;
+  }
+  while (x->used > 0 && x->words[x->used - 1] == 0) {
+    x->used--;
+  }
+}
+
+/* The shortest digits of the positive finite double BITS, nearest to it,
+ * by Burger and Dybvig's free-format algorithm.  The double is R/S, and
+ * its boundaries are (R - M_MINUS)/S and (R + M_PLUS)/S. */
+static int exact_shortest_digits(uint64_t bits, char *digits, int *point)
+{
+  DIY_FP v = double_diy_fp(bits);
+  int even = (v.f & 1) == 0;
+  int lower_closer = double_lower_boundary_closer(bits);
+  BIGNUM r, s, m_plus, m_minus;
+  int bit_length = 0, k, length = 0;
+  uint64_t f;
+
+  bignum_set(&r, v.f);
+  bignum_set(&s, 1);
+  bignum_set(&m_plus, 1);
+  bignum_set(&m_minus, 1);
+  if (v.e >= 0) {
+    bignum_shift_left(&r, v.e + (lower_closer ? 2 : 1));
+    bignum_shift_left(&s, lower_closer ? 2 : 1);
+    bignum_shift_left(&m_plus, v.e + (lower_closer ? 1 : 0));
+    bignum_shift_left(&m_minus, v.e);
+  } else {
+    bignum_shift_left(&r, lower_closer ? 2 : 1);
+    bignum_shift_left(&s, (lower_closer ? 2 : 1) - v.e);
+    bignum_shift_left(&m_plus, lower_closer ? 1 : 0);
+  }
+
+  /* Estimate k = ceil(log10(v)) from below, by at most one. */
+  for (f = v.f; f != 0; f >>= 1) {
+    bit_length++;
+  }
+  {
+    double estimate = (v.e + bit_length - 1) * 0.30102999566398114 - 1e-10;
+    k = (int)estimate;
+    if (estimate > k) {
+      k++;
+    }
+  }
+  if (k >= 0) {
+    bignum_multiply_power_ten(&s, k);
+  } else {
+    bignum_multiply_power_ten(&r, -k);
+    bignum_multiply_power_ten(&m_plus, -k);
+    bignum_multiply_power_ten(&m_minus, -k);
+  }
+  {
+    int high = bignum_plus_compare(&r, &m_plus, &s);
+    if (even ? high >= 0 : high > 0) {
+      bignum_multiply_small(&s, 10);
+      k++;
+    }
+  }
+
+  for (;;) {
+    int digit = 0, low_done, high_done, high;
+    bignum_multiply_small(&r, 10);
+    bignum_multiply_small(&m_plus, 10);
+    bignum_multiply_small(&m_minus, 10);
+    while (bignum_compare(&r, &s) >= 0) {
+      bignum_subtract(&r, &s);
+      digit++;
+    }
+    low_done = bignum_compare(&r, &m_minus);
+    low_done = even ? low_done <= 0 : low_done < 0;
+    high = bignum_plus_compare(&r, &m_plus, &s);
+    high_done = even ? high >= 0 : high > 0;
+    if (low_done && high_done) {
+      /* Either way is short enough, so round to nearest, ties to even. */
+      int half = bignum_plus_compare(&r, &r, &s);
+      if (half > 0 || (half == 0 && digit % 2 != 0)) {
+        digit++;
+      }
+    } else if (high_done) {
+      digit++;
+    }
+    digits[length++] = (char)('0' + digit);
+    if (low_done || high_done) {
+      break;
+    }
+  }
+  *point = k;
+  return length;
+}
+
+
+/// Formatting
+
+static int write_exponent(char *buffer, int exponent)
+{
+  char reversed[4];
+  int count = 0, length = 0;
+  if (exponent < 0) {
+    buffer[length++] = '-';
+    exponent = -exponent;
+  }
+  do {
+    reversed[count++] = (char)('0' + exponent % 10);
+    exponent /= 10;
+  } while (exponent != 0);
+  while (count > 0) {
+    buffer[length++] = reversed[--count];
+  }
+  return length;
+}
+
+int dylan_double_to_string(double value, char *buffer)
+{
+  uint64_t bits;
+  char digits[SHORTEST_DIGITS_SIZE];
+  int length = 0, count, point, exponent, i;
+
+  memcpy(&bits, &value, sizeof(bits));
+  if (double_biased_exponent(bits) == 0x7FF) {
+    if ((bits & DOUBLE_FRACTION_MASK) != 0) {
+      strcpy(buffer, "{NaN}d0");
+    } else {
+      strcpy(buffer, (bits >> 63) ? "-{infinity}d0" : "+{infinity}d0");
+    }
+    return (int)strlen(buffer);
+  }
+  if (bits >> 63) {
+    buffer[length++] = '-';
+    bits &= ~(UINT64_C(1) << 63);
+  }
+  if (bits == 0) {
+    strcpy(&buffer[length], "0.0d0");
+    return length + 5;
+  }
+
+  count = grisu3(bits, digits, &point);
+  if (count == 0) {
+    count = exact_shortest_digits(bits, digits, &point);
+  }
+
+  /* The value is 0.DIGITS * 10^POINT, so its leading digit is worth
+   * 10^(POINT - 1). */
+  exponent = point - 1;
+  if (exponent >= -4 && exponent < 16) {
+    if (point <= 0) {
+      buffer[length++] = '0';
+      buffer[length++] = '.';
+      for (i = point; i < 0; i++) {
+        buffer[length++] = '0';
+      }
+      memcpy(&buffer[length], digits, count);
+      length += count;
+    } else {
+      for (i = 0; i < point; i++) {
+        buffer[length++] = i < count ? digits[i] : '0';
+      }
+      buffer[length++] = '.';
+      if (count > point) {
+        memcpy(&buffer[length], &digits[point], count - point);
+        length += count - point;
+      } else {
+        buffer[length++] = '0';
+      }
+    }
+    exponent = 0;
+  } else {
+    buffer[length++] = digits[0];
+    buffer[length++] = '.';
+    if (count > 1) {
+      memcpy(&buffer[length], &digits[1], count - 1);
+      length += count - 1;
+    } else {
+      buffer[length++] = '0';
+    }
+  }
+  buffer[length++] = 'd';
+  length += write_exponent(&buffer[length], exponent);
+  buffer[length] = '\0';
+  return length;
+}
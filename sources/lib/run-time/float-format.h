@@ -0,0 +1,27 @@
+#ifndef FLOAT_FORMAT_H_
+#define FLOAT_FORMAT_H_
+
+/* Shortest round-trip printing of double floats
+ *
+ * dylan_double_to_string writes the shortest decimal that reads back as
+ * exactly the same double, and of those the one nearest to it, in Dylan
+ * literal syntax: "0.1d0", "-1234.5d0", "1.0d16", "5.0d-324".  Numbers
+ * from 1.0d-4 up to but not including 1.0d16 are written positionally,
+ * others with an exponent.  NaNs and infinities are written as
+ * float-to-string writes them.
+ *
+ * Digits come from Grisu3 (Loitsch, "Printing Floating-Point Numbers
+ * Quickly and Accurately with Integers", PLDI 2010), which needs only
+ * 64-bit integer arithmetic.  For the few doubles where Grisu3 can't
+ * prove its answer shortest it gives up, and they are done exactly with
+ * bignums instead (Burger and Dybvig's free-format algorithm).
+ */
+
+/* Enough for any double, with its terminating NUL. */
+#define DYLAN_DOUBLE_STRING_SIZE 32
+
+/* Writes VALUE into BUFFER, which must hold DYLAN_DOUBLE_STRING_SIZE
+ * characters, and returns the number written, not counting the NUL. */
+extern int dylan_double_to_string(double value, char *buffer);
+
+#endif
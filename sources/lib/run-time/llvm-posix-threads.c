@@ -9,9 +9,23 @@
 #include <semaphore.h>
 #include <sys/time.h>
 
+/* On Linux, simple and recursive locks and notifications are built
+ * directly on futexes rather than on a pthread mutex and condition
+ * variable; see "Futex locks" below.
+ */
+#if defined(OPEN_DYLAN_PLATFORM_LINUX)
+#  define USE_FUTEX_LOCKS
+#  include <limits.h>
+#  include <stdint.h>
+#  include <time.h>
+#  include <linux/futex.h>
+#  include <sys/syscall.h>
+#endif
+
 #include "llvm-runtime.h"
 #include "mm.h"
 #include "thread-utils.h"
+#include "lock-profiler.h"
 
 // The BDW GC wants to wrap pthreads functions
 #if defined(GC_USE_BOEHM)
@@ -72,24 +86,54 @@ typedef struct semaphore {
   struct mc mc;
   intptr_t count;
   intptr_t max_count;
+  LOCK_PROFILE *profile;
 } SEMAPHORE;
 
+#if defined(USE_FUTEX_LOCKS)
+
+// The owner is only ever set to the current thread by the thread
+// holding the lock, and cleared by it before releasing, so any thread
+// can tell whether it is the owner without further synchronization.
+typedef struct simple_lock {
+  uint32_t state;
+  pthread_t owner;
+  LOCK_PROFILE *profile;
+} SIMPLELOCK;
+
+typedef struct recursive_lock {
+  uint32_t state;
+  pthread_t owner;
+  intptr_t recursion_count;
+  LOCK_PROFILE *profile;
+} RECURSIVELOCK;
+
+// Bumped by each release, so a waiter can sleep until it changes.
+typedef struct notification {
+  uint32_t sequence;
+} NOTIFICATION;
+
+#else
+
 typedef struct simple_lock {
   struct mc mc;
   pthread_t owner;
   bool locked;
+  LOCK_PROFILE *profile;
 } SIMPLELOCK;
 
 typedef struct recursive_lock {
   struct mc mc;
   pthread_t owner;
   intptr_t recursion_count;
+  LOCK_PROFILE *profile;
 } RECURSIVELOCK;
 
 typedef struct notification {
   struct mc mc;
 } NOTIFICATION;
 
+#endif
+
 
 /// Thread variables
 
@@ -461,6 +505,21 @@ void primitive_sleep(dylan_value m)
 
 /// Semaphores
 
+// The name a lock was made with, for the lock profiler.
+static const char *lock_name(dylan_value n)
+{
+  if (n == &KPfalseVKi) {
+    return NULL;
+  }
+  return (const char *) ((struct KLbyte_stringGVKd *) n)->string_element;
+}
+
+// primitive-lock-contention-count
+dylan_value primitive_lock_contention_count(dylan_value n)
+{
+  return I(lock_profile_contention_count(lock_name(n)));
+}
+
 static dylan_value mc_init(mc *mc)
 {
   RETURN_IF_ERROR(pthread_mutex_init(&mc->mutex, NULL), GENERAL_ERROR);
@@ -492,6 +551,7 @@ dylan_value primitive_make_semaphore(dylan_value l, dylan_value n, dylan_value i
 
   semaphore->count = ((intptr_t) i) >> 2;
   semaphore->max_count = ((intptr_t) m) >> 2;
+  semaphore->profile = lock_profile_make("semaphore", lock_name(n), semaphore);
 
   lock->handle1 = (D) semaphore;
 
@@ -540,6 +600,8 @@ dylan_value primitive_wait_for_semaphore_timed(dylan_value l, dylan_value ms)
 
   RETURN_IF_ERROR(pthread_mutex_lock(&semaphore->mc.mutex), GENERAL_ERROR);
 
+  uint64_t start
+    = semaphore->count <= 0 ? lock_profile_wait_start(semaphore->profile) : 0;
   while (semaphore->count <= 0) {
     int rc = pthread_cond_timedwait(&semaphore->mc.cond,
                                     &semaphore->mc.mutex,
@@ -558,6 +620,9 @@ dylan_value primitive_wait_for_semaphore_timed(dylan_value l, dylan_value ms)
 
   RETURN_IF_ERROR(pthread_mutex_unlock(&semaphore->mc.mutex), GENERAL_ERROR);
 
+  lock_profile_waited(semaphore->profile, start);
+  lock_profile_acquired(semaphore->profile);
+
   return OK;
 }
 
@@ -570,6 +635,8 @@ dylan_value primitive_wait_for_semaphore(dylan_value l)
 
   RETURN_IF_ERROR(pthread_mutex_lock(&semaphore->mc.mutex), GENERAL_ERROR);
 
+  uint64_t start
+    = semaphore->count <= 0 ? lock_profile_wait_start(semaphore->profile) : 0;
   while (semaphore->count <= 0) {
     RETURN_IF_ERROR(pthread_cond_wait(&semaphore->mc.cond, 
 				      &semaphore->mc.mutex),
@@ -580,6 +647,9 @@ dylan_value primitive_wait_for_semaphore(dylan_value l)
 
   RETURN_IF_ERROR(pthread_mutex_unlock(&semaphore->mc.mutex), GENERAL_ERROR);
 
+  lock_profile_waited(semaphore->profile, start);
+  lock_profile_acquired(semaphore->profile);
+
   return OK;
 }
 
@@ -598,6 +668,460 @@ dylan_value primitive_destroy_semaphore(dylan_value l)
 }
 
 
+
+/// Futex locks
+//
+// A lock is a single word: 0 when it is free, 1 when it is held, and 2
+// when it is held and somebody may be asleep waiting for it (Drepper's
+// "Futexes Are Tricky", mutex 3).  Taking a free lock is one
+// compare-and-swap and releasing one nobody waits for is one exchange,
+// with no system call.  A thread that finds the lock held spins for a
+// little while in case the owner is about to let go, then marks the
+// lock contended and sleeps in the kernel until it is released.
+
+#if defined(USE_FUTEX_LOCKS)
+
+#define FUTEX_LOCK_FREE      0
+#define FUTEX_LOCK_HELD      1
+#define FUTEX_LOCK_CONTENDED 2
+
+// Times round the spin loop before going to sleep.
+#define FUTEX_LOCK_SPIN_LIMIT 100
+
+static inline void cpu_relax(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+// Sleep while *word is expected, until the absolute CLOCK_MONOTONIC
+// deadline if there is one.  Returns ETIMEDOUT if the deadline passed
+// and 0 otherwise, including when *word had already changed or the
+// wait was interrupted, so callers must check again either way.
+static int futex_wait(uint32_t *word, uint32_t expected,
+                      const struct timespec *deadline)
+{
+  long rc;
+  if (deadline == NULL) {
+    rc = syscall(SYS_futex, word, FUTEX_WAIT | FUTEX_PRIVATE_FLAG,
+                 expected, NULL, NULL, 0);
+  } else {
+    rc = syscall(SYS_futex, word, FUTEX_WAIT_BITSET | FUTEX_PRIVATE_FLAG,
+                 expected, deadline, NULL, FUTEX_BITSET_MATCH_ANY);
+  }
+  if (rc == -1 && errno == ETIMEDOUT) {
+    return ETIMEDOUT;
+  }
+  return 0;
+}
+
+static void futex_wake(uint32_t *word, int count)
+{
+  syscall(SYS_futex, word, FUTEX_WAKE | FUTEX_PRIVATE_FLAG,
+          count, NULL, NULL, 0);
+}
+
+static void compute_monotonic_deadline(struct timespec *deadline, long ms)
+{
+  clock_gettime(CLOCK_MONOTONIC, deadline);
+  deadline->tv_sec += ms / 1000;
+  deadline->tv_nsec += (ms % 1000) * 1000000;
+  if (deadline->tv_nsec >= 1000000000L) {
+    deadline->tv_sec += deadline->tv_nsec / 1000000000L;
+    deadline->tv_nsec = deadline->tv_nsec % 1000000000L;
+  }
+}
+
+// Take the lock if it is free.
+static inline bool futex_lock_try_acquire(uint32_t *state)
+{
+  uint32_t c = FUTEX_LOCK_FREE;
+  return __atomic_compare_exchange_n(state, &c, FUTEX_LOCK_HELD, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+}
+
+// Wait for a lock that was found held.  Returns 0 once it is ours, or
+// ETIMEDOUT.
+static int futex_lock_acquire_contended(uint32_t *state,
+                                        const struct timespec *deadline)
+{
+  // Spin while the lock is held but nobody is asleep on it, which is
+  // when the owner is most likely to be about to release it.
+  uint32_t c = __atomic_load_n(state, __ATOMIC_RELAXED);
+  for (int i = 0; i < FUTEX_LOCK_SPIN_LIMIT && c != FUTEX_LOCK_CONTENDED; ++i) {
+    cpu_relax();
+    c = __atomic_load_n(state, __ATOMIC_RELAXED);
+    if (c == FUTEX_LOCK_FREE
+        && __atomic_compare_exchange_n(state, &c, FUTEX_LOCK_HELD, false,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+      return 0;
+    }
+  }
+
+  // Sleep.  Having slept, we can't tell whether anybody else still is,
+  // so the lock stays marked contended once we get it.
+  c = __atomic_exchange_n(state, FUTEX_LOCK_CONTENDED, __ATOMIC_ACQUIRE);
+  while (c != FUTEX_LOCK_FREE) {
+    if (futex_wait(state, FUTEX_LOCK_CONTENDED, deadline) == ETIMEDOUT) {
+      return ETIMEDOUT;
+    }
+    c = __atomic_exchange_n(state, FUTEX_LOCK_CONTENDED, __ATOMIC_ACQUIRE);
+  }
+  return 0;
+}
+
+// Returns 0 once the lock is held, or ETIMEDOUT.
+static inline int futex_lock_acquire(uint32_t *state, LOCK_PROFILE *profile,
+                                     const struct timespec *deadline)
+{
+  if (!futex_lock_try_acquire(state)) {
+    uint64_t start = lock_profile_wait_start(profile);
+    if (futex_lock_acquire_contended(state, deadline) == ETIMEDOUT) {
+      return ETIMEDOUT;
+    }
+    lock_profile_waited(profile, start);
+  }
+  lock_profile_acquired(profile);
+  return 0;
+}
+
+static inline void futex_lock_release(uint32_t *state)
+{
+  if (__atomic_exchange_n(state, FUTEX_LOCK_FREE, __ATOMIC_RELEASE)
+      == FUTEX_LOCK_CONTENDED) {
+    futex_wake(state, 1);
+  }
+}
+
+static inline bool owned_by_self(pthread_t *owner)
+{
+  return pthread_equal(__atomic_load_n(owner, __ATOMIC_RELAXED),
+                       pthread_self());
+}
+
+static inline void set_owner(pthread_t *owner, pthread_t thread)
+{
+  __atomic_store_n(owner, thread, __ATOMIC_RELAXED);
+}
+
+
+/// Recursive locks
+
+// primitive-make-recursive-lock
+dylan_value primitive_make_recursive_lock(dylan_value l, dylan_value n)
+{
+  struct KLrecursive_lockGYthreadsVdylan *lock
+    = (struct KLrecursive_lockGYthreadsVdylan *) l;
+  RECURSIVELOCK *rlock;
+
+  rlock = MMAllocMisc(sizeof(RECURSIVELOCK));
+  if (rlock == NULL) {
+    return GENERAL_ERROR;
+  }
+
+  rlock->state = FUTEX_LOCK_FREE;
+  rlock->owner = (pthread_t) 0;
+  rlock->recursion_count = 0;
+  rlock->profile = lock_profile_make("recursive lock", lock_name(n), rlock);
+
+  lock->handle1 = (D) rlock;
+  return OK;
+}
+
+// primitive-release-recursive-lock
+dylan_value primitive_release_recursive_lock(dylan_value l)
+{
+  struct KLrecursive_lockGYthreadsVdylan *lock
+    = (struct KLrecursive_lockGYthreadsVdylan *) l;
+  RECURSIVELOCK *rlock = (RECURSIVELOCK *) lock->handle1;
+
+  if (!owned_by_self(&rlock->owner) || rlock->recursion_count == 0) {
+    return NOT_LOCKED;
+  }
+
+  if (--rlock->recursion_count == 0) {
+    set_owner(&rlock->owner, (pthread_t) 0);
+    futex_lock_release(&rlock->state);
+  }
+
+  return OK;
+}
+
+// primitive-wait-for-recursive-lock
+dylan_value primitive_wait_for_recursive_lock(dylan_value l)
+{
+  struct KLrecursive_lockGYthreadsVdylan *lock
+    = (struct KLrecursive_lockGYthreadsVdylan *) l;
+  RECURSIVELOCK *rlock = (RECURSIVELOCK *) lock->handle1;
+
+  if (!owned_by_self(&rlock->owner)) {
+    futex_lock_acquire(&rlock->state, rlock->profile, NULL);
+    set_owner(&rlock->owner, pthread_self());
+  }
+  ++rlock->recursion_count;
+
+  return OK;
+}
+
+// primitive-wait-for-recursive-lock-timed
+dylan_value primitive_wait_for_recursive_lock_timed(dylan_value l, dylan_value ms)
+{
+  struct KLrecursive_lockGYthreadsVdylan *lock
+    = (struct KLrecursive_lockGYthreadsVdylan *) l;
+  RECURSIVELOCK *rlock = (RECURSIVELOCK *) lock->handle1;
+
+  if (!owned_by_self(&rlock->owner)) {
+    struct timespec deadline;
+    compute_monotonic_deadline(&deadline, ((intptr_t) ms) >> 2);
+    if (futex_lock_acquire(&rlock->state, rlock->profile, &deadline) == ETIMEDOUT) {
+      return TIMEOUT;
+    }
+    set_owner(&rlock->owner, pthread_self());
+  }
+  ++rlock->recursion_count;
+
+  return OK;
+}
+
+// primitive-owned-recursive-lock
+dylan_value primitive_owned_recursive_lock(dylan_value l)
+{
+  struct KLrecursive_lockGYthreadsVdylan *lock
+    = (struct KLrecursive_lockGYthreadsVdylan *) l;
+  RECURSIVELOCK *rlock = (RECURSIVELOCK *) lock->handle1;
+
+  if (owned_by_self(&rlock->owner) && rlock->recursion_count != 0) {
+    return I(1);                // owned
+  }
+  return I(0);                  // not owned
+}
+
+// primitive-destroy-recursive-lock
+dylan_value primitive_destroy_recursive_lock(dylan_value l)
+{
+  struct KLrecursive_lockGYthreadsVdylan *lock
+    = (struct KLrecursive_lockGYthreadsVdylan *) l;
+  RECURSIVELOCK *rlock = (RECURSIVELOCK *) lock->handle1;
+
+  MMFreeMisc(rlock, sizeof(RECURSIVELOCK));
+
+  return OK;
+}
+
+
+/// Simple locks
+
+// primitive-make-simple-lock
+dylan_value primitive_make_simple_lock(dylan_value l, dylan_value n)
+{
+  struct KLsimple_lockGYthreadsVdylan *lock
+    = (struct KLsimple_lockGYthreadsVdylan *) l;
+
+  SIMPLELOCK *slock = MMAllocMisc(sizeof(SIMPLELOCK));
+  if (slock == NULL) {
+    return GENERAL_ERROR;
+  }
+
+  slock->state = FUTEX_LOCK_FREE;
+  slock->owner = (pthread_t) 0;
+  slock->profile = lock_profile_make("simple lock", lock_name(n), slock);
+
+  lock->handle1 = (D) slock;
+  return OK;
+}
+
+// primitive-release-simple-lock
+dylan_value primitive_release_simple_lock(dylan_value l)
+{
+  struct KLsimple_lockGYthreadsVdylan *lock
+    = (struct KLsimple_lockGYthreadsVdylan *) l;
+  SIMPLELOCK *slock = (SIMPLELOCK *) lock->handle1;
+
+  if (!owned_by_self(&slock->owner)) {
+    return NOT_LOCKED;
+  }
+
+  set_owner(&slock->owner, (pthread_t) 0);
+  futex_lock_release(&slock->state);
+
+  return OK;
+}
+
+// primitive-wait-for-simple-lock
+dylan_value primitive_wait_for_simple_lock(dylan_value l)
+{
+  struct KLsimple_lockGYthreadsVdylan *lock
+    = (struct KLsimple_lockGYthreadsVdylan *) l;
+  SIMPLELOCK *slock = (SIMPLELOCK *) lock->handle1;
+
+  if (owned_by_self(&slock->owner)) {
+    return ALREADY_LOCKED;
+  }
+
+  futex_lock_acquire(&slock->state, slock->profile, NULL);
+  set_owner(&slock->owner, pthread_self());
+
+  return OK;
+}
+
+// primitive-wait-for-simple-lock-timed
+dylan_value primitive_wait_for_simple_lock_timed(dylan_value l, dylan_value ms)
+{
+  struct KLsimple_lockGYthreadsVdylan *lock
+    = (struct KLsimple_lockGYthreadsVdylan *) l;
+  SIMPLELOCK *slock = (SIMPLELOCK *) lock->handle1;
+
+  struct timespec deadline;
+  compute_monotonic_deadline(&deadline, ((intptr_t) ms) >> 2);
+
+  if (futex_lock_acquire(&slock->state, slock->profile, &deadline) == ETIMEDOUT) {
+    return TIMEOUT;
+  }
+  set_owner(&slock->owner, pthread_self());
+
+  return OK;
+}
+
+// primitive-owned-simple-lock
+dylan_value primitive_owned_simple_lock(dylan_value l)
+{
+  struct KLsimple_lockGYthreadsVdylan *lock
+    = (struct KLsimple_lockGYthreadsVdylan *) l;
+  SIMPLELOCK *slock = (SIMPLELOCK *) lock->handle1;
+
+  if (owned_by_self(&slock->owner)) {
+    return I(1);                // owned
+  }
+  return I(0);                  // not owned
+}
+
+// primitive-destroy-simple-lock
+dylan_value primitive_destroy_simple_lock(dylan_value l)
+{
+  struct KLsimple_lockGYthreadsVdylan *lock
+    = (struct KLsimple_lockGYthreadsVdylan *) l;
+  SIMPLELOCK *slock = (SIMPLELOCK *) lock->handle1;
+
+  MMFreeMisc(slock, sizeof(SIMPLELOCK));
+
+  return OK;
+}
+
+
+/// Notification
+//
+// A waiter reads the sequence number while it still holds the lock, and
+// a release has to hold the same lock to change it, so a release after
+// the waiter lets go of the lock always makes its futex wait return.
+
+// primitive-make-notification
+dylan_value primitive_make_notification(dylan_value n, dylan_value s)
+{
+  struct KLnotificationGYthreadsVdylan *notif
+    = (struct KLnotificationGYthreadsVdylan *) n;
+  NOTIFICATION *notification;
+
+  notification = MMAllocMisc(sizeof(NOTIFICATION));
+  if (notification == NULL) {
+    return GENERAL_ERROR;
+  }
+
+  notification->sequence = 0;
+
+  notif->handle1 = notification;
+  return OK;
+}
+
+// primitive-release-notification
+dylan_value primitive_release_notification(dylan_value n, dylan_value l)
+{
+  struct KLnotificationGYthreadsVdylan *notif
+    = (struct KLnotificationGYthreadsVdylan *) n;
+  NOTIFICATION *notification = (NOTIFICATION *) notif->handle1;
+
+  __atomic_add_fetch(&notification->sequence, 1, __ATOMIC_RELEASE);
+  futex_wake(&notification->sequence, 1);
+
+  return OK;
+}
+
+// primitive-release-all-notification
+dylan_value primitive_release_all_notification(dylan_value n, dylan_value l)
+{
+  struct KLnotificationGYthreadsVdylan *notif
+    = (struct KLnotificationGYthreadsVdylan *) n;
+  NOTIFICATION *notification = (NOTIFICATION *) notif->handle1;
+
+  __atomic_add_fetch(&notification->sequence, 1, __ATOMIC_RELEASE);
+  futex_wake(&notification->sequence, INT_MAX);
+
+  return OK;
+}
+
+// primitive-wait-for-notification
+dylan_value primitive_wait_for_notification(dylan_value n, dylan_value l)
+{
+  struct KLnotificationGYthreadsVdylan *notif
+    = (struct KLnotificationGYthreadsVdylan *) n;
+  NOTIFICATION *notification = (NOTIFICATION *) notif->handle1;
+
+  uint32_t sequence
+    = __atomic_load_n(&notification->sequence, __ATOMIC_ACQUIRE);
+
+  dylan_value rc = primitive_release_simple_lock(l);
+  if (rc != OK) {
+    return rc;
+  }
+
+  futex_wait(&notification->sequence, sequence, NULL);
+
+  return primitive_wait_for_simple_lock(l);
+}
+
+// primitive-wait-for-notification-timed
+dylan_value primitive_wait_for_notification_timed(dylan_value n, dylan_value l, dylan_value ms)
+{
+  struct KLnotificationGYthreadsVdylan *notif
+    = (struct KLnotificationGYthreadsVdylan *) n;
+  NOTIFICATION *notification = (NOTIFICATION *) notif->handle1;
+
+  struct timespec deadline;
+  compute_monotonic_deadline(&deadline, ((intptr_t) ms) >> 2);
+
+  uint32_t sequence
+    = __atomic_load_n(&notification->sequence, __ATOMIC_ACQUIRE);
+
+  dylan_value rc = primitive_release_simple_lock(l);
+  if (rc != OK) {
+    return rc;
+  }
+
+  int ret = futex_wait(&notification->sequence, sequence, &deadline);
+
+  rc = primitive_wait_for_simple_lock(l);
+  if (ret == ETIMEDOUT) {
+    return TIMEOUT;
+  }
+  return rc;
+}
+
+// primitive-destroy-notification
+dylan_value primitive_destroy_notification(dylan_value n)
+{
+  struct KLnotificationGYthreadsVdylan *notif
+    = (struct KLnotificationGYthreadsVdylan *) n;
+  NOTIFICATION *notification = (NOTIFICATION*) notif->handle1;
+
+  MMFreeMisc(notification, sizeof(NOTIFICATION));
+
+  return OK;
+}
+
+#else
+
 /// Recursive locks
 
 // primitive-make-recursive-lock
@@ -619,6 +1143,7 @@ dylan_value primitive_make_recursive_lock(dylan_value l, dylan_value n)
   }
 
   rlock->recursion_count = 0;
+  rlock->profile = lock_profile_make("recursive lock", lock_name(n), rlock);
 
   lock->handle1 = (D) rlock;
   return OK;
@@ -663,7 +1188,9 @@ dylan_value primitive_wait_for_recursive_lock(dylan_value l)
   RETURN_IF_ERROR(pthread_mutex_lock(&rlock->mc.mutex), GENERAL_ERROR);
 
   pthread_t self = pthread_self();
+  uint64_t start = 0;
   if (rlock->recursion_count != 0 && !pthread_equal(rlock->owner, self)) {
+    start = lock_profile_wait_start(rlock->profile);
     // Wait until the lock is no longer owned
     while (rlock->recursion_count != 0) {
       UNLOCK_RETURN_IF_ERROR(pthread_cond_wait(&rlock->mc.cond,
@@ -674,10 +1201,15 @@ dylan_value primitive_wait_for_recursive_lock(dylan_value l)
 
   // Claim the lock
   rlock->owner = self;
-  ++rlock->recursion_count;
+  bool outermost = rlock->recursion_count++ == 0;
 
   RETURN_IF_ERROR(pthread_mutex_unlock(&rlock->mc.mutex), GENERAL_ERROR);
 
+  if (outermost) {
+    lock_profile_waited(rlock->profile, start);
+    lock_profile_acquired(rlock->profile);
+  }
+
   return OK;
 }
 
@@ -694,7 +1226,9 @@ dylan_value primitive_wait_for_recursive_lock_timed(dylan_value l, dylan_value m
   RETURN_IF_ERROR(pthread_mutex_lock(&rlock->mc.mutex), GENERAL_ERROR);
 
   pthread_t self = pthread_self();
+  uint64_t start = 0;
   if (rlock->recursion_count != 0 && !pthread_equal(rlock->owner, self)) {
+    start = lock_profile_wait_start(rlock->profile);
     // Wait until the lock is no longer owned
     while (rlock->recursion_count != 0) {
       int rc = pthread_cond_timedwait(&rlock->mc.cond, &rlock->mc.mutex,
@@ -711,10 +1245,15 @@ dylan_value primitive_wait_for_recursive_lock_timed(dylan_value l, dylan_value m
 
   // Claim the lock
   rlock->owner = self;
-  ++rlock->recursion_count;
+  bool outermost = rlock->recursion_count++ == 0;
 
   RETURN_IF_ERROR(pthread_mutex_unlock(&rlock->mc.mutex), GENERAL_ERROR);
 
+  if (outermost) {
+    lock_profile_waited(rlock->profile, start);
+    lock_profile_acquired(rlock->profile);
+  }
+
   return OK;
 }
 
@@ -772,6 +1311,7 @@ dylan_value primitive_make_simple_lock(dylan_value l, dylan_value n)
     return rc;
   }
   slock->locked = false;
+  slock->profile = lock_profile_make("simple lock", lock_name(n), slock);
 
   lock->handle1 = (D) slock;
   return OK;
@@ -817,6 +1357,9 @@ dylan_value primitive_wait_for_simple_lock(dylan_value l)
 
   // Wait until the lock is no longer owned
   pthread_t self = pthread_self();
+  uint64_t start
+    = (slock->locked && !pthread_equal(slock->owner, self))
+        ? lock_profile_wait_start(slock->profile) : 0;
   while (slock->locked) {
     if (pthread_equal(slock->owner, self)) {
       pthread_mutex_unlock(&slock->mc.mutex);
@@ -832,6 +1375,9 @@ dylan_value primitive_wait_for_simple_lock(dylan_value l)
 
   RETURN_IF_ERROR(pthread_mutex_unlock(&slock->mc.mutex), GENERAL_ERROR);
 
+  lock_profile_waited(slock->profile, start);
+  lock_profile_acquired(slock->profile);
+
   return OK;
 }
 
@@ -847,6 +1393,7 @@ dylan_value primitive_wait_for_simple_lock_timed(dylan_value l, dylan_value ms)
 
   RETURN_IF_ERROR(pthread_mutex_lock(&slock->mc.mutex), GENERAL_ERROR);
 
+  uint64_t start = slock->locked ? lock_profile_wait_start(slock->profile) : 0;
   while (slock->locked) {
     int rc = pthread_cond_timedwait(&slock->mc.cond, &slock->mc.mutex, &deadline);
     if (rc != 0) {
@@ -867,6 +1414,9 @@ dylan_value primitive_wait_for_simple_lock_timed(dylan_value l, dylan_value ms)
 
   RETURN_IF_ERROR(pthread_mutex_unlock(&slock->mc.mutex), GENERAL_ERROR);
 
+  lock_profile_waited(slock->profile, start);
+  lock_profile_acquired(slock->profile);
+
   return OK;
 }
 
@@ -1057,3 +1607,5 @@ dylan_value primitive_destroy_notification(dylan_value n)
 
   return rc;
 }
+
+#endif
@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "lock-profiler.h"
+#include "stack-walker.h"
+
+bool dylan_lock_profiling = false;
+
+// Every profile ever made, newest first.  Profiles outlive their locks
+// so that the report still covers locks that have been finalized.
+static LOCK_PROFILE *lock_profiles = NULL;
+static pthread_mutex_t lock_profiles_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_once_t lock_profile_environment_once = PTHREAD_ONCE_INIT;
+
+static void lock_profile_dump_at_exit(void)
+{
+  primitive_dump_lock_profile();
+}
+
+static void lock_profile_read_environment(void)
+{
+  if (getenv("OPEN_DYLAN_LOCK_PROFILE") != NULL) {
+    dylan_lock_profiling = true;
+    atexit(lock_profile_dump_at_exit);
+  }
+}
+
+LOCK_PROFILE *lock_profile_make(const char *kind, const char *name,
+                                const void *lock)
+{
+  pthread_once(&lock_profile_environment_once, lock_profile_read_environment);
+  if (!dylan_lock_profiling) {
+    return NULL;
+  }
+
+  LOCK_PROFILE *profile = calloc(1, sizeof(LOCK_PROFILE));
+  if (profile == NULL) {
+    return NULL;
+  }
+  if (name != NULL) {
+    snprintf(profile->name, sizeof profile->name, "%s", name);
+  } else {
+    snprintf(profile->name, sizeof profile->name, "unnamed %s %p", kind, lock);
+  }
+
+  pthread_mutex_lock(&lock_profiles_lock);
+  profile->next = lock_profiles;
+  lock_profiles = profile;
+  pthread_mutex_unlock(&lock_profiles_lock);
+
+  return profile;
+}
+
+uint64_t lock_profile_now(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t) now.tv_sec * 1000000000u + (uint64_t) now.tv_nsec;
+}
+
+// Called after a thread that found the lock taken has acquired it, so
+// only when it has already spent a while waiting.
+void lock_profile_record_wait(LOCK_PROFILE *profile, uint64_t start)
+{
+  uint64_t wait = lock_profile_now() - start;
+
+  char site[sizeof profile->sites[0].name];
+  if (dylan_callstack_site(site, sizeof site) != 0) {
+    strcpy(site, "unknown");
+  }
+
+  pthread_mutex_lock(&lock_profiles_lock);
+
+  profile->contended++;
+  profile->wait_ns += wait;
+  if (wait > profile->max_wait_ns) {
+    profile->max_wait_ns = wait;
+  }
+
+  LOCK_PROFILE_SITE *entry = NULL;
+  LOCK_PROFILE_SITE *least = &profile->sites[0];
+  for (int i = 0; i < LOCK_PROFILE_SITES; ++i) {
+    LOCK_PROFILE_SITE *candidate = &profile->sites[i];
+    if (candidate->waits == 0 || strcmp(candidate->name, site) == 0) {
+      entry = candidate;
+      break;
+    }
+    if (candidate->wait_ns < least->wait_ns) {
+      least = candidate;
+    }
+  }
+  if (entry == NULL) {
+    entry = least;
+    entry->waits = 0;
+    entry->wait_ns = 0;
+  }
+  if (entry->waits == 0) {
+    strcpy(entry->name, site);
+  }
+  entry->waits++;
+  entry->wait_ns += wait;
+
+  pthread_mutex_unlock(&lock_profiles_lock);
+}
+
+// primitive-start-lock-profiling
+void primitive_start_lock_profiling(void)
+{
+  pthread_once(&lock_profile_environment_once, lock_profile_read_environment);
+  dylan_lock_profiling = true;
+}
+
+// primitive-stop-lock-profiling
+void primitive_stop_lock_profiling(void)
+{
+  dylan_lock_profiling = false;
+}
+
+uint64_t lock_profile_contention_count(const char *name)
+{
+  uint64_t count = 0;
+  if (name == NULL) {
+    return 0;
+  }
+  pthread_mutex_lock(&lock_profiles_lock);
+  for (LOCK_PROFILE *p = lock_profiles; p != NULL; p = p->next) {
+    if (strcmp(p->name, name) == 0) {
+      count += p->contended;
+    }
+  }
+  pthread_mutex_unlock(&lock_profiles_lock);
+  return count;
+}
+
+static int compare_wait(const void *a, const void *b)
+{
+  const LOCK_PROFILE *pa = *(const LOCK_PROFILE * const *) a;
+  const LOCK_PROFILE *pb = *(const LOCK_PROFILE * const *) b;
+  if (pa->wait_ns != pb->wait_ns) {
+    return pa->wait_ns < pb->wait_ns ? 1 : -1;
+  }
+  if (pa->acquisitions != pb->acquisitions) {
+    return pa->acquisitions < pb->acquisitions ? 1 : -1;
+  }
+  return 0;
+}
+
+static int compare_site_wait(const void *a, const void *b)
+{
+  const LOCK_PROFILE_SITE *sa = a;
+  const LOCK_PROFILE_SITE *sb = b;
+  if (sa->wait_ns != sb->wait_ns) {
+    return sa->wait_ns < sb->wait_ns ? 1 : -1;
+  }
+  return 0;
+}
+
+// primitive-dump-lock-profile
+//
+// Writes every lock that has been taken since profiling started to
+// stderr, longest total wait first, with the sites that waited for it.
+void primitive_dump_lock_profile(void)
+{
+  pthread_mutex_lock(&lock_profiles_lock);
+
+  size_t count = 0;
+  for (LOCK_PROFILE *p = lock_profiles; p != NULL; p = p->next) {
+    if (p->acquisitions != 0) {
+      ++count;
+    }
+  }
+
+  LOCK_PROFILE **sorted = malloc((count + 1) * sizeof(LOCK_PROFILE *));
+  if (sorted == NULL) {
+    pthread_mutex_unlock(&lock_profiles_lock);
+    return;
+  }
+  size_t i = 0;
+  for (LOCK_PROFILE *p = lock_profiles; p != NULL; p = p->next) {
+    if (p->acquisitions != 0) {
+      sorted[i++] = p;
+    }
+  }
+  qsort(sorted, count, sizeof(LOCK_PROFILE *), compare_wait);
+
+  fprintf(stderr, "Lock contention profile (%zu locks):\n", count);
+  fprintf(stderr, "%14s %12s %14s %12s  %s\n",
+          "acquisitions", "contended", "total wait us", "max wait us", "lock");
+  for (i = 0; i < count; ++i) {
+    LOCK_PROFILE *p = sorted[i];
+    fprintf(stderr, "%14ju %12ju %14ju %12ju  %s\n",
+            (uintmax_t) p->acquisitions, (uintmax_t) p->contended,
+            (uintmax_t) (p->wait_ns / 1000), (uintmax_t) (p->max_wait_ns / 1000),
+            p->name);
+
+    LOCK_PROFILE_SITE sites[LOCK_PROFILE_SITES];
+    memcpy(sites, p->sites, sizeof sites);
+    qsort(sites, LOCK_PROFILE_SITES, sizeof sites[0], compare_site_wait);
+    for (int j = 0; j < LOCK_PROFILE_SITES && sites[j].waits != 0; ++j) {
+      fprintf(stderr, "      %ju waits, %ju us, at %s\n",
+              (uintmax_t) sites[j].waits, (uintmax_t) (sites[j].wait_ns / 1000),
+              sites[j].name);
+    }
+  }
+
+  free(sorted);
+  pthread_mutex_unlock(&lock_profiles_lock);
+}
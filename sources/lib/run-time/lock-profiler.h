@@ -0,0 +1,81 @@
+#ifndef LOCK_PROFILER_H_
+#define LOCK_PROFILER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Lock contention profiling
+ *
+ * When profiling is on, each lock made gets a LOCK_PROFILE counting how
+ * often it is taken, how often a thread had to wait for it and for how
+ * long, and where in the program the waiting threads were.  Locks made
+ * while profiling is off have no profile, and cost only a test of the
+ * NULL pointer.
+ *
+ * Profiling is started by primitive_start_lock_profiling, or by setting
+ * OPEN_DYLAN_LOCK_PROFILE in the environment, in which case the profile
+ * is also written to stderr when the program exits.
+ */
+
+/* The call sites that waited longest for each lock, kept approximately:
+ * when the table is full, a new site replaces the one with the least
+ * total wait. */
+#define LOCK_PROFILE_SITES 8
+
+typedef struct lock_profile_site {
+  uint64_t waits;
+  uint64_t wait_ns;
+  char name[120];
+} LOCK_PROFILE_SITE;
+
+typedef struct lock_profile LOCK_PROFILE;
+
+struct lock_profile {
+  LOCK_PROFILE *next;
+  uint64_t acquisitions;
+  uint64_t contended;
+  uint64_t wait_ns;
+  uint64_t max_wait_ns;
+  char name[80];
+  LOCK_PROFILE_SITE sites[LOCK_PROFILE_SITES];
+};
+
+extern bool dylan_lock_profiling;
+
+/* Returns NULL unless profiling is on.  NAME may be NULL for an unnamed
+ * lock, which is then identified by KIND and its address. */
+extern LOCK_PROFILE *lock_profile_make(const char *kind, const char *name,
+                                       const void *lock);
+
+extern uint64_t lock_profile_now(void);
+extern void lock_profile_record_wait(LOCK_PROFILE *profile, uint64_t start);
+
+static inline void lock_profile_acquired(LOCK_PROFILE *profile)
+{
+  if (profile != NULL && dylan_lock_profiling) {
+    __atomic_fetch_add(&profile->acquisitions, 1, __ATOMIC_RELAXED);
+  }
+}
+
+/* Bracket a wait for a lock: */
+static inline uint64_t lock_profile_wait_start(LOCK_PROFILE *profile)
+{
+  return (profile != NULL && dylan_lock_profiling) ? lock_profile_now() : 0;
+}
+
+static inline void lock_profile_waited(LOCK_PROFILE *profile, uint64_t start)
+{
+  if (profile != NULL && start != 0) {
+    lock_profile_record_wait(profile, start);
+  }
+}
+
+extern void primitive_start_lock_profiling(void);
+extern void primitive_stop_lock_profiling(void);
+extern void primitive_dump_lock_profile(void);
+
+/* The waits recorded for every profile made with NAME, for the
+ * run-times' primitive_lock_contention_count. */
+extern uint64_t lock_profile_contention_count(const char *name);
+
+#endif // LOCK_PROFILER_H_
@@ -140,6 +140,34 @@ static size_t  TLV_vector_offset = 2;
 
 extern void *make_dylan_vector(size_t size);
 
+/* The parked thread cache
+ *
+ * Creating an OS thread, its TEB and its TLV vector for every Dylan
+ * thread, and tearing them down again when it finishes, dominates the
+ * cost of short-lived threads.  When OPEN_DYLAN_THREAD_CACHE is set to
+ * a number, up to that many OS threads whose Dylan thread has finished
+ * are parked instead of exiting, keeping their TEB, their TLV vector
+ * and their registration with the collector, and primitive_make_thread
+ * hands the next new Dylan threads to them.  The TLV vector of a
+ * recycled thread is reset to the defaults before its new thread runs.
+ * A thread left parked for THREAD_CACHE_IDLE_MSECS exits, and so does
+ * one whose Dylan thread finished holding a lock, since lock owners are
+ * recorded by TEB.
+ */
+#define THREAD_CACHE_IDLE_MSECS 10000
+
+typedef struct parked_thread {
+  pthread_t              tid;
+  pthread_cond_t         wakeup;
+  DTHREAD               *thread;        // to run next, NULL while parked
+  struct parked_thread  *next;
+} PARKED_THREAD;
+
+static pthread_mutex_t  thread_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static PARKED_THREAD   *parked_threads = NULL;
+static int              parked_thread_count = 0;
+static int              thread_cache_limit = 0;
+
 /*****************************************************************************/
 /* LOCAL FUNCTION DECLARATIONS                                               */
 /*****************************************************************************/
@@ -425,6 +453,64 @@ static void setup_tlv_vector(DTHREAD *thread)
   pthread_mutex_unlock(&tlv_vector_list_lock);
 }
 
+/*
+ * Give the TLV vector of a thread that is no longer on the active
+ * thread list the default values again.  If thread variables were added
+ * since it was made and the vector is too small, drop it so that
+ * setup_tlv_vector makes a new one.  Called with tlv_vector_list_lock
+ * held.
+ */
+static void reset_tlv_vector(void)
+{
+  TLV_VECTOR tlv_vector = get_tlv_vector();
+
+  if (tlv_vector) {
+    if ((size_t)(tlv_vector[1]) < (size_t)(default_tlv_vector[1])) {
+      set_tlv_vector(NULL);
+    } else {
+      copy_tlv_vector(tlv_vector, default_tlv_vector);
+    }
+  }
+}
+
+/*
+ * Called when a thread finishes and its OS thread is parked, so that the
+ * finished thread's values aren't kept alive while it waits.
+ */
+static void park_tlv_vector(void)
+{
+  trace_tlv("Parking TLV vector %p", get_tlv_vector());
+
+  pthread_mutex_lock(&tlv_vector_list_lock);
+  reset_tlv_vector();
+  pthread_mutex_unlock(&tlv_vector_list_lock);
+}
+
+/*
+ * Put a recycled thread's TLV vector back on the active thread list,
+ * which it left when the previous thread finished.  It is reset again,
+ * since thread variables may have been added while it was parked.
+ */
+static void recycle_tlv_vector(DTHREAD *thread)
+{
+  TEB         *teb;
+  TLV_VECTOR   tlv_vector;
+
+  trace_tlv("Recycling TLV vector for thread %p", thread);
+
+  teb = get_teb();
+
+  pthread_mutex_lock(&tlv_vector_list_lock);
+
+  reset_tlv_vector();
+  tlv_vector = get_tlv_vector();
+  if (tlv_vector) {
+    add_tlv_vector(thread, teb, tlv_vector);
+  }
+
+  pthread_mutex_unlock(&tlv_vector_list_lock);
+}
+
 /*
  * Called once from _Init_Run_Time() to initialize globally.
  */
@@ -442,6 +528,11 @@ void initialize_threads_primitives(void)
 
   // Initialize the TLV vector for the initial thread
   setup_tlv_vector(NULL);
+
+  const char *cache = getenv("OPEN_DYLAN_THREAD_CACHE");
+  if (cache != NULL) {
+    thread_cache_limit = atoi(cache);
+  }
 }
 
 
@@ -449,17 +540,20 @@ void initialize_threads_primitives(void)
 /* THREAD PRIMITIVES                                                         */
 /*****************************************************************************/
 
-static void *trampoline (void *arg)
+/* Run the Dylan THREAD on the current OS thread, which has the TEB
+ * TEB.  RECYCLED says whether the OS thread has run another Dylan
+ * thread before.
+ */
+static dylan_value run_thread(DTHREAD *thread, TEB *teb, int recycled)
 {
   dylan_value result, f;
-  DTHREAD    *thread = (DTHREAD *)arg;
   THREAD     *rthread;
 
   assert(thread != NULL);
 
   rthread = (THREAD*)(thread->handle2);
 
-  rthread->teb = make_teb();
+  rthread->teb = teb;
 
   f = rthread->function;
 
@@ -467,8 +561,13 @@ static void *trampoline (void *arg)
     const char *raw = primitive_string_as_raw(thread->thread_name);
     trace_threads("Thread %p has name \"%s\"", thread, raw);
     dylan_set_current_thread_name(raw);
+  } else if (recycled) {
+    dylan_set_current_thread_name("");
   }
 
+  if (recycled) {
+    recycle_tlv_vector(thread);
+  }
   setup_tlv_vector(thread);
 
   trace_threads("Thread %p starts function %p", thread, f);
@@ -484,12 +583,136 @@ static void *trampoline (void *arg)
   pthread_cond_broadcast(&thread_exit_event);
   pthread_mutex_unlock(&thread_join_lock);
 
+  return result;
+}
+
+/* Park the current OS thread in the thread cache, if there is room,
+ * until primitive_make_thread gives it another Dylan thread to run.
+ * Returns that thread, or NULL if the OS thread should exit.
+ */
+static DTHREAD *park_thread(PARKED_THREAD *parked, TEB *teb)
+{
+  DTHREAD         *next = NULL;
+  void            *tlv_vector;
+  struct timespec  deadline;
+
+  // A thread that finishes holding a lock keeps it, as it did before
+  // threads were cached.  The next thread on this OS thread would get
+  // the same TEB, and so appear to own the lock, so exit instead.
+  if (teb->held_locks != 0) {
+    trace_threads("Not parking OS thread %p, which holds %ld locks",
+                  (void *)parked->tid, teb->held_locks);
+    return NULL;
+  }
+
+  // Drop the finished thread's state, so that the collector doesn't
+  // keep its objects alive through the TEB or its thread variables
+  // while we're parked.
+  tlv_vector = teb->tlv_vector;
+  memset(teb, 0, sizeof(TEB));
+  teb->uwp_frame = &teb->top_uwp_frame;
+  teb->tlv_vector = tlv_vector;
+  park_tlv_vector();
+
+  pthread_mutex_lock(&thread_cache_lock);
+
+  if (parked_thread_count < thread_cache_limit) {
+    trace_threads("Parking OS thread %p", (void *)parked->tid);
+
+    parked->thread = NULL;
+    parked->next = parked_threads;
+    parked_threads = parked;
+    parked_thread_count++;
+
+    timespec_current(&deadline);
+    timespec_add_msecs(&deadline, THREAD_CACHE_IDLE_MSECS);
+    while (parked->thread == NULL) {
+      if (pthread_cond_timedwait(&parked->wakeup, &thread_cache_lock,
+                                 &deadline) == ETIMEDOUT
+          && parked->thread == NULL) {
+        // Idle for too long, so take ourselves off the list and exit
+        PARKED_THREAD **link = &parked_threads;
+        while (*link != parked) {
+          link = &(*link)->next;
+        }
+        *link = parked->next;
+        parked_thread_count--;
+        break;
+      }
+    }
+    next = parked->thread;
+  }
+
+  pthread_mutex_unlock(&thread_cache_lock);
+
+  return next;
+}
+
+/* Hand THREAD to a parked OS thread.  Returns 0 if none is parked.
+ */
+static int resume_parked_thread(DTHREAD *thread)
+{
+  PARKED_THREAD *parked;
+  THREAD        *rthread = (THREAD*)(thread->handle2);
+
+  pthread_mutex_lock(&thread_cache_lock);
+
+  parked = parked_threads;
+  if (parked != NULL) {
+    trace_threads("Resuming OS thread %p for thread %p",
+                  (void *)parked->tid, thread);
+    parked_threads = parked->next;
+    parked_thread_count--;
+    rthread->tid = parked->tid;
+    parked->thread = thread;
+    pthread_cond_signal(&parked->wakeup);
+  }
+
+  pthread_mutex_unlock(&thread_cache_lock);
+
+  return parked != NULL;
+}
+
+static void *trampoline (void *arg)
+{
+  DTHREAD       *thread = (DTHREAD *)arg;
+  dylan_value    result;
+  TEB           *teb;
+  PARKED_THREAD  parked;
+  int            recycled = 0;
+
+  teb = make_teb();
+
+  parked.tid = pthread_self();
+  pthread_cond_init(&parked.wakeup, NULL);
+
+  do {
+    result = run_thread(thread, teb, recycled);
+    recycled = 1;
+  } while (thread_cache_limit > 0
+           && (thread = park_thread(&parked, teb)) != NULL);
+
+  pthread_cond_destroy(&parked.wakeup);
+
   free_teb();
 
   return result;
 }
 
 
+/* The name of a lock for its profile, or NULL if it has none. */
+static const char *lock_name(dylan_value n)
+{
+  return n == &KPfalseVKi ? NULL : primitive_string_as_raw(n);
+}
+
+// primitive-lock-contention-count
+dylan_value primitive_lock_contention_count(dylan_value n)
+{
+  return I(lock_profile_contention_count(lock_name(n)));
+}
+
+
 /* 1 */
 dylan_value primitive_make_thread(dylan_value t, dylan_value f, DBOOL s)
 {
@@ -512,6 +735,10 @@ dylan_value primitive_make_thread(dylan_value t, dylan_value f, DBOOL s)
   thread->handle1 = 0;       // runtime thread flags
   thread->handle2 = rthread; // runtime thread object
 
+  if (thread_cache_limit > 0 && resume_parked_thread(thread)) {
+    return OK;
+  }
+
   // param.sched_priority = priority_map(priority);
 
   if (pthread_attr_init(&attr)) {
@@ -709,7 +936,14 @@ dylan_value primitive_wait_for_simple_lock(dylan_value l)
   teb = get_teb();
   slock = lock->handle;
 
-  int res = pthread_mutex_lock(&slock->mutex);
+  int res = pthread_mutex_trylock(&slock->mutex);
+  if (res == EBUSY) {
+    uint64_t start = lock_profile_wait_start(slock->profile);
+    res = pthread_mutex_lock(&slock->mutex);
+    if (res == 0) {
+      lock_profile_waited(slock->profile, start);
+    }
+  }
   if (res == EDEADLK) {
     return ALREADY_LOCKED;
   }
@@ -719,6 +953,8 @@ dylan_value primitive_wait_for_simple_lock(dylan_value l)
   }
 
   slock->owner = teb;
+  teb->held_locks++;
+  lock_profile_acquired(slock->profile);
 
   return OK;
 }
@@ -737,7 +973,14 @@ dylan_value primitive_wait_for_recursive_lock(dylan_value l)
   teb = get_teb();
   rlock = lock->handle;
 
-  int res = pthread_mutex_lock(&rlock->mutex);
+  int res = pthread_mutex_trylock(&rlock->mutex);
+  if (res == EBUSY) {
+    uint64_t start = lock_profile_wait_start(rlock->profile);
+    res = pthread_mutex_lock(&rlock->mutex);
+    if (res == 0) {
+      lock_profile_waited(rlock->profile, start);
+    }
+  }
   if (res == EDEADLK) {
     return ALREADY_LOCKED;
   }
@@ -746,7 +989,10 @@ dylan_value primitive_wait_for_recursive_lock(dylan_value l)
     return GENERAL_ERROR;
   }
 
-  atomic_increment(&rlock->count);
+  if (atomic_increment(&rlock->count) == 1) {
+    teb->held_locks++;
+    lock_profile_acquired(rlock->profile);
+  }
 
   rlock->owner = teb;
 
@@ -765,11 +1011,16 @@ dylan_value primitive_wait_for_semaphore(dylan_value l)
 
   semaphore = lock->handle;
 
+  uint64_t start = 0;
+
 #ifdef HAVE_POSIX_SEMAPHORES
-  int res = sem_wait(&semaphore->semaphore);
-  if (res != 0) {
-    MSG0("wait-for-semaphore: sem_wait returned error\n");
-    return GENERAL_ERROR;
+  if (sem_trywait(&semaphore->semaphore) != 0) {
+    start = lock_profile_wait_start(semaphore->profile);
+    int res = sem_wait(&semaphore->semaphore);
+    if (res != 0) {
+      MSG0("wait-for-semaphore: sem_wait returned error\n");
+      return GENERAL_ERROR;
+    }
   }
 #else
   if (pthread_mutex_lock(&semaphore->mutex)) {
@@ -777,6 +1028,9 @@ dylan_value primitive_wait_for_semaphore(dylan_value l)
     return GENERAL_ERROR;
   }
 
+  if (semaphore->count <= 0) {
+    start = lock_profile_wait_start(semaphore->profile);
+  }
   while (semaphore->count <= 0) {
     pthread_cond_wait(&semaphore->cond, &semaphore->mutex);
   }
@@ -789,6 +1043,9 @@ dylan_value primitive_wait_for_semaphore(dylan_value l)
   }
 #endif
 
+  lock_profile_waited(semaphore->profile, start);
+  lock_profile_acquired(semaphore->profile);
+
   return OK;
 }
 
@@ -854,6 +1111,7 @@ dylan_value primitive_wait_for_simple_lock_timed(dylan_value l, dylan_value ms)
   }
 
   slock->owner = teb;
+  teb->held_locks++;
 
   return OK;
 }
@@ -892,7 +1150,9 @@ dylan_value primitive_wait_for_recursive_lock_timed(dylan_value l, dylan_value m
     return GENERAL_ERROR;
   }
 
-  atomic_increment(&rlock->count);
+  if (atomic_increment(&rlock->count) == 1) {
+    teb->held_locks++;
+  }
 
   rlock->owner = teb;
 
@@ -1020,6 +1280,8 @@ dylan_value primitive_release_simple_lock(dylan_value l)
     return GENERAL_ERROR;
   }
 
+  get_teb()->held_locks--;
+
   return OK;
 }
 
@@ -1044,7 +1306,9 @@ dylan_value primitive_release_recursive_lock(dylan_value l)
     return GENERAL_ERROR;
   }
 
-  atomic_decrement(&rlock->count);
+  if (atomic_decrement(&rlock->count) == 0) {
+    get_teb()->held_locks--;
+  }
 
   return OK;
 }
@@ -1146,8 +1410,6 @@ dylan_value primitive_make_recursive_lock(dylan_value l, dylan_value n)
   int                 res;
   pthread_mutexattr_t attrs;
 
-  ignore(n);
-
   assert(lock != NULL);
 
   rlock = (RECURSIVELOCK *)MMAllocMisc(sizeof(RECURSIVELOCK));
@@ -1174,6 +1436,7 @@ dylan_value primitive_make_recursive_lock(dylan_value l, dylan_value n)
 
   rlock->owner = 0;
   rlock->count = 0;
+  rlock->profile = lock_profile_make("recursive-lock", lock_name(n), rlock);
 
   lock->handle = rlock;
 
@@ -1215,8 +1478,6 @@ dylan_value primitive_make_simple_lock(dylan_value l, dylan_value n)
   int                 res;
   pthread_mutexattr_t attrs;
 
-  ignore(n);
-
   assert(lock != NULL);
 
   slock = (SIMPLELOCK *)MMAllocMisc(sizeof(SIMPLELOCK));
@@ -1242,6 +1503,7 @@ dylan_value primitive_make_simple_lock(dylan_value l, dylan_value n)
   }
 
   slock->owner = 0;
+  slock->profile = lock_profile_make("simple-lock", lock_name(n), slock);
 
   lock->handle = slock;
 
@@ -1324,8 +1586,6 @@ dylan_value primitive_make_semaphore(dylan_value l, dylan_value n, dylan_value i
   ZINT        initial = zinitial >> 2;
   ZINT        max   = zmax >> 2;
 
-  ignore(n);
-
   assert(lock != NULL);
   assert(IS_ZINT(zinitial));
   assert(IS_ZINT(zmax));
@@ -1361,6 +1621,8 @@ dylan_value primitive_make_semaphore(dylan_value l, dylan_value n, dylan_value i
   semaphore->max_count = max;
 #endif
 
+  semaphore->profile = lock_profile_make("semaphore", lock_name(n), semaphore);
+
   lock->handle = semaphore;
 
   return OK;
@@ -1466,12 +1728,7 @@ primitive_assign_atomic_memory(void * * location, Z newval)
 */
 
 /* 32 */
-/*
-ZINT
-primitive_conditional_update_memory(void * * location, Z newval, Z oldval)
-{
-}
-*/
+/* primitive_conditional_update_memory is a macro in run-time.h */
 
 
 /* 33 */
@@ -1629,6 +1886,7 @@ dylan_value primitive_unlock_simple_lock(dylan_value l)
     return OK;
   }
 
+  slock->owner->held_locks--;
   slock->owner = 0;
 
   if (pthread_mutex_unlock(&slock->mutex)) {
@@ -1656,6 +1914,7 @@ dylan_value primitive_unlock_recursive_lock(dylan_value l)
     return OK;
   }
 
+  rlock->owner->held_locks--;
   rlock->owner = 0;
   rlock->count = 0;
 
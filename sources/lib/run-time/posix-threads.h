@@ -24,6 +24,8 @@
 #include <pthread.h>
 #include <semaphore.h>
 
+#include "lock-profiler.h"
+
 #ifndef THREADS_RUN_TIME_H
 #define THREADS_RUN_TIME_H
 
@@ -160,12 +162,14 @@ typedef struct thread {
 typedef struct simple_lock {
   TEB             *owner; // for owned?
   pthread_mutex_t  mutex;
+  LOCK_PROFILE    *profile;
 } SIMPLELOCK;
 
 typedef struct recursive_lock {
   TEB             *owner; // for owned?
   long             count;
   pthread_mutex_t  mutex;
+  LOCK_PROFILE    *profile;
 } RECURSIVELOCK;
 
 typedef struct semaphore {
@@ -177,6 +181,7 @@ typedef struct semaphore {
   ZINT            count;
   ZINT            max_count;
 #endif
+  LOCK_PROFILE   *profile;
 } SEMAPHORE;
 
 typedef struct {
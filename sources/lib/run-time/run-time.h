@@ -128,6 +128,17 @@ typedef void*                   D;
      ((old_val) == (var) ? (var = (new_val), DTRUE) : DFALSE)
 #endif
 
+#ifdef OPEN_DYLAN_COMPILER_GCC_LIKE
+#  define CONDITIONAL_UPDATE_MEMORY(location, new_val, old_val) \
+     ((DBOOL)__sync_bool_compare_and_swap((dylan_value *)(location), \
+                                          old_val, new_val))
+#else
+#  warning missing primitive CONDITIONAL_UPDATE_MEMORY - thread safety compromised
+#  define CONDITIONAL_UPDATE_MEMORY(location, new_val, old_val) \
+     ((old_val) == *(dylan_value *)(location) \
+      ? (*(dylan_value *)(location) = (new_val), (DBOOL)1) : (DBOOL)0)
+#endif
+
 #ifdef OPEN_DYLAN_COMPILER_GCC_LIKE
 #  define SYNCHRONIZE_SIDE_EFFECTS() __sync_synchronize()
 #else
@@ -285,6 +296,10 @@ typedef struct _dylan_implementation_class {
   dylan_value           the_class_properties;
   struct _dylan_class * the_class;
   dylan_value           the_wrapper;
+  dylan_value           repeated_slot_descriptor;
+  dylan_value           instance_slot_descriptors;
+  dylan_value           dispatch_key;
+  dylan_value           class_slot_storage;
 } dylan_implementation_class;
 
 /* This corresponds to <type> defined in
@@ -327,6 +342,9 @@ typedef struct _dylan_class {
 #define ICLASS_CLASS(x) \
     (((dylan_implementation_class*)(x))->the_class)
 
+#define ICLASS_CLASS_SLOT_STORAGE(x) \
+    (((dylan_implementation_class*)(x))->class_slot_storage)
+
 #define WRAPPER_ICLASS(x) \
     (((Wrapper*)(x))->iclass)
 
@@ -514,15 +532,31 @@ typedef struct _mv {
 #define MV_SET_ELT(n, t)        (get_teb()->return_values.value[n] = (t))
 #define MV_SET_COUNT(n)         (get_teb()->return_values.count = (n))
 
+/* Spills of values that must survive a nested call go into an area in
+   the caller's frame, and only into the heap when there are more values
+   than the area holds.  The area is a prefix of an MV. */
+
+#define MV_SPILL_AREA_VALUES    8
+
+typedef struct _mv_spill_area {
+  int           count;
+  dylan_value   value[MV_SPILL_AREA_VALUES];
+} MV_SPILL_AREA;
+
+#define MV_SPILL_LOCAL(fv, area) \
+  MV_SPILL_INTO((fv), (MV*)&(area), MV_SPILL_AREA_VALUES)
+
 extern dylan_value MV_SPILL (dylan_value first_value);
+extern dylan_value MV_SPILL_INTO (dylan_value first_value, MV *dest, int capacity);
 extern dylan_value MV_UNSPILL (dylan_value spill_t);
 extern dylan_value MV_GET_REST_AT (dylan_value first_value, DSINT first);
 extern dylan_value MV_SET_REST_AT (dylan_value v, DSINT first);
 extern dylan_value MV_CHECK_TYPE_REST (dylan_value first_value, dylan_value rest_type, int n, ...);
 
 #define MV_CHECK_TYPE_PROLOGUE(fv) \
+  MV spill_area;                   \
   MV *spill;                       \
-  spill = (MV*)MV_SPILL(fv)
+  spill = (MV*)MV_SPILL_INTO(fv, &spill_area, VALUES_MAX)
 
 #define MV_CHECK_TYPE_EPILOGUE()   \
   MV_UNSPILL((dylan_value)spill)
@@ -593,6 +627,7 @@ typedef struct _teb {
         void *thread;
         void *thread_handle;
         void *tlv_vector;
+        long  held_locks;       /* simple and recursive locks held */
 
         /* argument buffers (used in dispatch, primitives...) */
         dylan_value arguments[MAX_ARGUMENTS];
@@ -838,6 +873,31 @@ extern dylan_value SET_KEYWORD_METHOD_SIG(dylan_value, dylan_value);
 #define CREF(n) (_fn->environment[(n)])
 #define MREF    (_fn)
 
+/* Closures that the compiler has found to have dynamic extent are made
+   in the frame of the function that makes them, as in the other back
+   ends.  The storage is a CLOSURE_AREA declared with the closure's
+   temporary, like an MV_SPILL_AREA, so a closure made in a loop reuses
+   it rather than growing the stack.  The _IN functions fill it in. */
+
+extern dylan_value MAKE_CLOSURE_IN(void*, dylan_value, int);
+extern dylan_value MAKE_CLOSURE_SIG_IN(void*, dylan_value, dylan_value, int);
+extern dylan_value MAKE_CLOSURE_INITD_IN(void*, dylan_value, int, ...);
+extern dylan_value MAKE_CLOSURE_INITD_SIG_IN(void*, dylan_value, dylan_value, int, ...);
+extern dylan_value MAKE_KEYWORD_CLOSURE_IN(void*, dylan_value, int);
+extern dylan_value MAKE_KEYWORD_CLOSURE_SIG_IN(void*, dylan_value, dylan_value, int);
+extern dylan_value MAKE_KEYWORD_CLOSURE_INITD_IN(void*, dylan_value, int, ...);
+extern dylan_value MAKE_KEYWORD_CLOSURE_INITD_SIG_IN(void*, dylan_value, dylan_value, int, ...);
+
+#define CLOSURE_BYTES(n) \
+  (sizeof(dylan_simple_closure_method) + (n) * sizeof(dylan_value))
+#define KEYWORD_CLOSURE_BYTES(n) \
+  (sizeof(dylan_keyword_closure_method) + (n) * sizeof(dylan_value))
+
+#define CLOSURE_AREA(name, n) \
+  dylan_value name[(CLOSURE_BYTES(n) + sizeof(dylan_value) - 1) / sizeof(dylan_value)]
+#define KEYWORD_CLOSURE_AREA(name, n) \
+  dylan_value name[(KEYWORD_CLOSURE_BYTES(n) + sizeof(dylan_value) - 1) / sizeof(dylan_value)]
+
 /*
  * PRIMITIVES
  */
@@ -2009,6 +2069,10 @@ extern dylan_value primitive_release_notification(dylan_value n, dylan_value l);
 extern void primitive_detach_thread(dylan_value t);
 extern void primitive_thread_yield(void);
 extern void primitive_sleep(dylan_value ms);
+extern void primitive_start_lock_profiling(void);
+extern void primitive_stop_lock_profiling(void);
+extern void primitive_dump_lock_profile(void);
+extern dylan_value primitive_lock_contention_count(dylan_value n);
 extern dylan_value primitive_make_simple_lock(dylan_value l, dylan_value n);
 extern dylan_value primitive_allocate_thread_variable(dylan_value i);
 extern dylan_value primitive_read_thread_variable(dylan_value h);
@@ -2020,6 +2084,8 @@ extern dylan_value primitive_unlock_recursive_lock(dylan_value l);
 
 #define primitive_sequence_point() SEQUENCE_POINT()
 #define primitive_synchronize_side_effects() SYNCHRONIZE_SIDE_EFFECTS()
+#define primitive_conditional_update_memory(location, new_val, old_val) \
+  CONDITIONAL_UPDATE_MEMORY(location, new_val, old_val)
 
 /* RUN-TIME CALLBACKS */
 
@@ -2057,10 +2123,10 @@ extern dylan_value primitive_preboot_symbols ();
 #define ENGINE_reserved_slot_a_setter 25
 #define ENGINE_reserved_slot_b_getter 26
 #define ENGINE_reserved_slot_b_setter 27
-#define ENGINE_reserved_repeated_slot_a_getter 28
-#define ENGINE_reserved_repeated_slot_a_setter 29
-#define ENGINE_reserved_repeated_slot_b_getter 30
-#define ENGINE_reserved_repeated_slot_b_setter 31
+#define ENGINE_raw_word_repeated_instance_slot_getter 28
+#define ENGINE_raw_word_repeated_instance_slot_setter 29
+#define ENGINE_raw_double_float_repeated_instance_slot_getter 30
+#define ENGINE_raw_double_float_repeated_instance_slot_setter 31
 #define ENGINE_typecheck 32
 #define ENGINE_if_type 33
 #define ENGINE_linear_by_class 34
@@ -0,0 +1,473 @@
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+#include "sampling-profiler.h"
+#include "stack-walker.h"
+
+// Samples are kept in fixed size chunks handed out from one pool that
+// is mapped when profiling starts, so the signal handler never
+// allocates.  Each thread fills a chunk of its own and takes a fresh one
+// when that is full, so the only shared state the handler updates is
+// the pool's next chunk index and the counters.  A sample is its depth
+// followed by that many instruction pointers.
+
+#define SAMPLE_CHUNK_WORDS 16384
+#define SAMPLE_CHUNKS 512
+
+typedef struct sample_chunk {
+  uintptr_t used;
+  uintptr_t words[SAMPLE_CHUNK_WORDS];
+} SAMPLE_CHUNK;
+
+static SAMPLE_CHUNK *sample_chunks = NULL;
+static uintptr_t next_sample_chunk = 0;
+static uintptr_t samples_recorded = 0;
+static uintptr_t samples_dropped = 0;
+static int sampling = 0;
+static int sampling_interval = SAMPLING_PROFILER_INTERVAL;
+
+// Bumped by each start, so that threads don't go on filling a chunk
+// they were given by an earlier run.
+static unsigned sampling_run = 0;
+
+static pthread_mutex_t sampling_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Initial-exec, so that the handler's first access doesn't allocate.
+static __thread SAMPLE_CHUNK *thread_chunk
+  __attribute__((tls_model("initial-exec"))) = NULL;
+static __thread unsigned thread_run
+  __attribute__((tls_model("initial-exec"))) = 0;
+
+static void record_sample(const uintptr_t *ips, int depth)
+{
+  SAMPLE_CHUNK *chunk = thread_chunk;
+  unsigned run = __atomic_load_n(&sampling_run, __ATOMIC_ACQUIRE);
+  if (thread_run != run
+      || chunk == NULL
+      || chunk->used + 1 + depth > SAMPLE_CHUNK_WORDS) {
+    uintptr_t index
+      = __atomic_fetch_add(&next_sample_chunk, 1, __ATOMIC_RELAXED);
+    if (index >= SAMPLE_CHUNKS) {
+      thread_chunk = NULL;
+      __atomic_fetch_add(&samples_dropped, 1, __ATOMIC_RELAXED);
+      return;
+    }
+    chunk = &sample_chunks[index];
+    thread_chunk = chunk;
+    thread_run = run;
+  }
+
+  uintptr_t used = chunk->used;
+  chunk->words[used] = (uintptr_t) depth;
+  for (int i = 0; i < depth; ++i) {
+    chunk->words[used + 1 + i] = ips[i];
+  }
+  __atomic_store_n(&chunk->used, used + 1 + depth, __ATOMIC_RELEASE);
+  __atomic_fetch_add(&samples_recorded, 1, __ATOMIC_RELAXED);
+}
+
+static void sampling_handler(int signal, siginfo_t *info, void *context)
+{
+  int saved_errno = errno;
+  if (__atomic_load_n(&sampling, __ATOMIC_ACQUIRE)) {
+    uintptr_t ips[SAMPLING_PROFILER_MAX_DEPTH];
+    int depth = dylan_callstack_ips(ips, SAMPLING_PROFILER_MAX_DEPTH);
+    if (depth > 0) {
+      record_sample(ips, depth);
+    }
+  }
+  errno = saved_errno;
+}
+
+static int set_sampling_timer(int interval)
+{
+  struct itimerval timer;
+  timer.it_interval.tv_sec = interval / 1000000;
+  timer.it_interval.tv_usec = interval % 1000000;
+  timer.it_value = timer.it_interval;
+  return setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+int dylan_sampling_profiler_start(int interval)
+{
+  if (interval <= 0) {
+    interval = SAMPLING_PROFILER_INTERVAL;
+  }
+
+  pthread_mutex_lock(&sampling_lock);
+  if (sampling) {
+    pthread_mutex_unlock(&sampling_lock);
+    return -1;
+  }
+
+  if (sample_chunks == NULL) {
+    // Untouched chunks cost address space only.
+    void *pool = mmap(NULL, SAMPLE_CHUNKS * sizeof(SAMPLE_CHUNK),
+                      PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                      -1, 0);
+    if (pool == MAP_FAILED) {
+      pthread_mutex_unlock(&sampling_lock);
+      return -1;
+    }
+    sample_chunks = pool;
+  } else {
+    uintptr_t used = next_sample_chunk;
+    for (uintptr_t i = 0; i < used && i < SAMPLE_CHUNKS; ++i) {
+      sample_chunks[i].used = 0;
+    }
+  }
+  next_sample_chunk = 0;
+  samples_recorded = 0;
+  samples_dropped = 0;
+  sampling_interval = interval;
+  __atomic_add_fetch(&sampling_run, 1, __ATOMIC_RELEASE);
+
+  struct sigaction action;
+  memset(&action, 0, sizeof action);
+  action.sa_sigaction = sampling_handler;
+  action.sa_flags = SA_SIGINFO | SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  if (sigaction(SIGPROF, &action, NULL) != 0) {
+    pthread_mutex_unlock(&sampling_lock);
+    return -1;
+  }
+
+  __atomic_store_n(&sampling, 1, __ATOMIC_RELEASE);
+  if (set_sampling_timer(interval) != 0) {
+    __atomic_store_n(&sampling, 0, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&sampling_lock);
+    return -1;
+  }
+  pthread_mutex_unlock(&sampling_lock);
+  return 0;
+}
+
+int dylan_sampling_profiler_stop(void)
+{
+  pthread_mutex_lock(&sampling_lock);
+  if (sampling) {
+    set_sampling_timer(0);
+    __atomic_store_n(&sampling, 0, __ATOMIC_RELEASE);
+  }
+  pthread_mutex_unlock(&sampling_lock);
+  return (int) __atomic_load_n(&samples_recorded, __ATOMIC_RELAXED);
+}
+
+int dylan_sampling_profiler_dropped(void)
+{
+  return (int) __atomic_load_n(&samples_dropped, __ATOMIC_RELAXED);
+}
+
+// Calls FN on each sample recorded, with the lock held.
+static void for_each_sample(void (*fn)(const uintptr_t *ips, int depth,
+                                       void *arg),
+                            void *arg)
+{
+  uintptr_t chunks = __atomic_load_n(&next_sample_chunk, __ATOMIC_RELAXED);
+  if (chunks > SAMPLE_CHUNKS) {
+    chunks = SAMPLE_CHUNKS;
+  }
+  for (uintptr_t i = 0; i < chunks; ++i) {
+    SAMPLE_CHUNK *chunk = &sample_chunks[i];
+    uintptr_t used = __atomic_load_n(&chunk->used, __ATOMIC_ACQUIRE);
+    for (uintptr_t word = 0; word < used; ) {
+      int depth = (int) chunk->words[word];
+      fn(&chunk->words[word + 1], depth, arg);
+      word += 1 + depth;
+    }
+  }
+}
+
+
+/// Folded stacks
+
+// Each instruction pointer is looked up once per profile written, and
+// each function symbolized once per run, by the stack walker's cache.
+
+typedef struct frame_name {
+  uintptr_t ip;
+  char *name;                   // NULL for a frame left out of stacks
+} FRAME_NAME;
+
+typedef struct frame_names {
+  FRAME_NAME *entries;
+  size_t size;                  // a power of two
+  size_t count;
+} FRAME_NAMES;
+
+static size_t frame_name_hash(uintptr_t ip, size_t size)
+{
+  return (size_t) ((ip >> 2) * 0x9E3779B97F4A7C15u) & (size - 1);
+}
+
+static FRAME_NAME *frame_name_entry(FRAME_NAMES *names, uintptr_t ip)
+{
+  size_t i = frame_name_hash(ip, names->size);
+  while (names->entries[i].ip != 0 && names->entries[i].ip != ip) {
+    i = (i + 1) & (names->size - 1);
+  }
+  return &names->entries[i];
+}
+
+static int frame_names_grow(FRAME_NAMES *names)
+{
+  FRAME_NAMES grown = { NULL, names->size * 2, names->count };
+  grown.entries = calloc(grown.size, sizeof(FRAME_NAME));
+  if (grown.entries == NULL) {
+    return -1;
+  }
+  for (size_t i = 0; i < names->size; ++i) {
+    if (names->entries[i].ip != 0) {
+      *frame_name_entry(&grown, names->entries[i].ip) = names->entries[i];
+    }
+  }
+  free(names->entries);
+  *names = grown;
+  return 0;
+}
+
+static int frame_name_add(FRAME_NAMES *names, uintptr_t ip,
+                          const DYLAN_SYMBOL *symbol)
+{
+  FRAME_NAME *entry = frame_name_entry(names, ip);
+  if (entry->ip == 0) {
+    if (2 * (names->count + 1) > names->size) {
+      if (frame_names_grow(names) != 0) {
+        return -1;
+      }
+      entry = frame_name_entry(names, ip);
+    }
+    entry->ip = ip;
+    if (symbol->kind == 0) {
+      entry->name = NULL;
+    }
+    else if (symbol->name != NULL) {
+      entry->name = strdup(symbol->name);
+    }
+    else {
+      char buf[2 + 2 * sizeof(uintptr_t) + 1];
+      snprintf(buf, sizeof buf, "%#jx", (uintmax_t) ip);
+      entry->name = strdup(buf);
+    }
+    names->count++;
+  }
+  return 0;
+}
+
+typedef struct folded_stacks {
+  FRAME_NAMES names;
+  char **lines;
+  size_t count;
+  size_t capacity;
+  int failed;
+} FOLDED_STACKS;
+
+static void fold_sample(const uintptr_t *ips, int depth, void *arg)
+{
+  FOLDED_STACKS *stacks = arg;
+  if (stacks->failed || stacks->count == stacks->capacity) {
+    return;
+  }
+
+  // Symbolize the frames not seen before in one go
+  uintptr_t missing[SAMPLING_PROFILER_MAX_DEPTH];
+  int missing_count = 0;
+  for (int i = 0; i < depth; ++i) {
+    if (frame_name_entry(&stacks->names, ips[i])->ip == 0) {
+      missing[missing_count++] = ips[i];
+    }
+  }
+  if (missing_count > 0) {
+    DYLAN_SYMBOL symbols[SAMPLING_PROFILER_MAX_DEPTH];
+    dylan_symbolize_ips(missing, symbols, missing_count);
+    for (int i = 0; i < missing_count; ++i) {
+      if (frame_name_add(&stacks->names, missing[i], &symbols[i]) != 0) {
+        stacks->failed = 1;
+        return;
+      }
+    }
+  }
+
+  size_t length = 0;
+  const char *frames[SAMPLING_PROFILER_MAX_DEPTH];
+  int count = 0;
+  for (int i = depth - 1; i >= 0; --i) {
+    const char *name = frame_name_entry(&stacks->names, ips[i])->name;
+    if (name != NULL) {
+      frames[count++] = name;
+      length += strlen(name) + 1;
+    }
+  }
+  if (count == 0) {
+    return;
+  }
+
+  char *line = malloc(length);
+  if (line == NULL) {
+    stacks->failed = 1;
+    return;
+  }
+  char *end = line;
+  for (int i = 0; i < count; ++i) {
+    size_t n = strlen(frames[i]);
+    memcpy(end, frames[i], n);
+    end += n;
+    *end++ = ';';
+  }
+  end[-1] = '\0';
+  stacks->lines[stacks->count++] = line;
+}
+
+static int compare_lines(const void *a, const void *b)
+{
+  return strcmp(*(char * const *) a, *(char * const *) b);
+}
+
+int dylan_sampling_profiler_write_folded(const char *path)
+{
+  pthread_mutex_lock(&sampling_lock);
+  if (sampling || sample_chunks == NULL) {
+    pthread_mutex_unlock(&sampling_lock);
+    return -1;
+  }
+
+  FOLDED_STACKS stacks;
+  memset(&stacks, 0, sizeof stacks);
+  stacks.names.size = 4096;
+  stacks.names.entries = calloc(stacks.names.size, sizeof(FRAME_NAME));
+  // A handler that was already running when sampling stopped may still
+  // add a sample, which is left out.
+  stacks.capacity = __atomic_load_n(&samples_recorded, __ATOMIC_RELAXED);
+  stacks.lines = malloc((stacks.capacity + 1) * sizeof(char *));
+  FILE *out = fopen(path, "w");
+  int result = -1;
+  if (stacks.names.entries != NULL && stacks.lines != NULL && out != NULL) {
+    for_each_sample(fold_sample, &stacks);
+    qsort(stacks.lines, stacks.count, sizeof(char *), compare_lines);
+    for (size_t i = 0; i < stacks.count; ) {
+      size_t j = i + 1;
+      while (j < stacks.count && strcmp(stacks.lines[i], stacks.lines[j]) == 0) {
+        ++j;
+      }
+      fprintf(out, "%s %zu\n", stacks.lines[i], j - i);
+      i = j;
+    }
+    result = stacks.failed ? -1 : 0;
+  }
+
+  if (out != NULL && fclose(out) != 0) {
+    result = -1;
+  }
+  for (size_t i = 0; i < stacks.count; ++i) {
+    free(stacks.lines[i]);
+  }
+  free(stacks.lines);
+  if (stacks.names.entries != NULL) {
+    for (size_t i = 0; i < stacks.names.size; ++i) {
+      free(stacks.names.entries[i].name);
+    }
+    free(stacks.names.entries);
+  }
+  pthread_mutex_unlock(&sampling_lock);
+  return result;
+}
+
+
+/// gperftools CPU profiles
+
+// A header, a record per sample of its count, its depth, and its
+// instruction pointers, a trailer, and the memory map that pprof needs
+// to find the binaries to symbolize the instruction pointers with.  All
+// but the memory map are native words.
+
+static void write_pprof_sample(const uintptr_t *ips, int depth, void *arg)
+{
+  FILE *out = arg;
+  uintptr_t record[2] = { 1, (uintptr_t) depth };
+  fwrite(record, sizeof record[0], 2, out);
+  fwrite(ips, sizeof ips[0], depth, out);
+}
+
+int dylan_sampling_profiler_write_pprof(const char *path)
+{
+  pthread_mutex_lock(&sampling_lock);
+  if (sampling || sample_chunks == NULL) {
+    pthread_mutex_unlock(&sampling_lock);
+    return -1;
+  }
+
+  FILE *out = fopen(path, "wb");
+  if (out == NULL) {
+    pthread_mutex_unlock(&sampling_lock);
+    return -1;
+  }
+
+  uintptr_t header[5] = { 0, 3, 0, (uintptr_t) sampling_interval, 0 };
+  fwrite(header, sizeof header[0], 5, out);
+  for_each_sample(write_pprof_sample, out);
+  uintptr_t trailer[3] = { 0, 1, 0 };
+  fwrite(trailer, sizeof trailer[0], 3, out);
+
+  FILE *maps = fopen("/proc/self/maps", "r");
+  if (maps != NULL) {
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof buf, maps)) > 0) {
+      fwrite(buf, 1, n, out);
+    }
+    fclose(maps);
+  }
+
+  int result = ferror(out) ? -1 : 0;
+  if (fclose(out) != 0) {
+    result = -1;
+  }
+  pthread_mutex_unlock(&sampling_lock);
+  return result;
+}
+
+
+/// Profiling a whole run
+
+static char *sampling_profile_prefix = NULL;
+
+static void sampling_profile_write_at_exit(void)
+{
+  dylan_sampling_profiler_stop();
+
+  size_t length = strlen(sampling_profile_prefix) + sizeof ".folded";
+  char *path = malloc(length);
+  if (path == NULL) {
+    return;
+  }
+  snprintf(path, length, "%s.folded", sampling_profile_prefix);
+  if (dylan_sampling_profiler_write_folded(path) != 0) {
+    fprintf(stderr, "Unable to write CPU profile to %s\n", path);
+  }
+  snprintf(path, length, "%s.prof", sampling_profile_prefix);
+  if (dylan_sampling_profiler_write_pprof(path) != 0) {
+    fprintf(stderr, "Unable to write CPU profile to %s\n", path);
+  }
+  free(path);
+}
+
+__attribute__((constructor))
+static void sampling_profile_read_environment(void)
+{
+  const char *prefix = getenv("OPEN_DYLAN_CPU_PROFILE");
+  if (prefix == NULL || *prefix == '\0') {
+    return;
+  }
+  const char *interval = getenv("OPEN_DYLAN_CPU_PROFILE_INTERVAL");
+  sampling_profile_prefix = strdup(prefix);
+  if (sampling_profile_prefix != NULL
+      && dylan_sampling_profiler_start(interval ? atoi(interval) : 0) == 0) {
+    atexit(sampling_profile_write_at_exit);
+  }
+}
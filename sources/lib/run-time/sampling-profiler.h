@@ -0,0 +1,50 @@
+#ifndef SAMPLING_PROFILER_H_
+#define SAMPLING_PROFILER_H_
+
+#include <stdint.h>
+
+/* Statistical CPU profiling
+ *
+ * While the profiler runs, SIGPROF interrupts whichever thread is using
+ * the CPU every interval of CPU time, and the handler records that
+ * thread's stack as raw instruction pointers in a buffer of its own.
+ * Nothing is looked up while sampling: the stacks are symbolized, and
+ * IEP names demangled, only when a profile is written.  Stacks need
+ * libunwind; without it no samples are recorded.
+ *
+ * Profiles can be written as folded stacks, one line of semicolon
+ * separated frames and a count per distinct stack as flamegraph.pl
+ * expects, and in the gperftools CPU profile format, which pprof reads
+ * and symbolizes against the binaries itself.
+ *
+ * Profiling is started by dylan_sampling_profiler_start, or for a whole
+ * run by setting OPEN_DYLAN_CPU_PROFILE to an output file prefix, in
+ * which case PREFIX.folded and PREFIX.prof are written when the program
+ * exits.  OPEN_DYLAN_CPU_PROFILE_INTERVAL sets the sampling interval in
+ * microseconds for that case.
+ */
+
+/* The default sampling interval, in microseconds of CPU time. */
+#define SAMPLING_PROFILER_INTERVAL 10000
+
+/* Frames recorded from the innermost one outwards; deeper stacks are
+ * truncated. */
+#define SAMPLING_PROFILER_MAX_DEPTH 128
+
+/* Starts sampling every INTERVAL microseconds of CPU time, discarding
+ * the samples of any earlier run.  Returns 0 on success, or -1 if the
+ * profiler is already running or could not be started. */
+extern int dylan_sampling_profiler_start(int interval);
+
+/* Stops sampling.  Returns the number of samples recorded. */
+extern int dylan_sampling_profiler_stop(void);
+
+/* The number of samples lost because the buffers were full. */
+extern int dylan_sampling_profiler_dropped(void);
+
+/* Write the samples recorded by the last run to PATH.  Return 0 on
+ * success, or -1 if the profiler is running or PATH can't be written. */
+extern int dylan_sampling_profiler_write_folded(const char *path);
+extern int dylan_sampling_profiler_write_pprof(const char *path);
+
+#endif // SAMPLING_PROFILER_H_
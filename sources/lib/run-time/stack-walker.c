@@ -1,6 +1,11 @@
+#define _GNU_SOURCE             // for dladdr
+#include <dlfcn.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+
+#include "stack-walker.h"
 
 #define ARRAY_LEN(x)            (sizeof(x)/sizeof((x)[0]))
 
@@ -381,6 +386,246 @@ static int interesting_function(const char *name)
                  sizeof(uninteresting[0]), entrycmp) == NULL;
 }
 
+// unw_get_proc_name_by_ip only appeared in libunwind 1.6, along with
+// the unw_local_addr_space that unw_get_proc_info_by_ip needs.
+#if UNW_VERSION_MAJOR > 1 \
+    || (UNW_VERSION_MAJOR == 1 && UNW_VERSION_MINOR >= 6)
+static int proc_name_by_ip(uintptr_t ip, char *buf, size_t size,
+                           uintptr_t *offset)
+{
+  unw_word_t off;
+  if (unw_get_proc_name_by_ip(unw_local_addr_space, (unw_word_t) ip,
+                              buf, size, &off, NULL) != 0) {
+    return -1;
+  }
+  *offset = (uintptr_t) off;
+  return 0;
+}
+
+static int proc_start_by_ip(uintptr_t ip, uintptr_t *start)
+{
+  unw_proc_info_t info;
+  if (unw_get_proc_info_by_ip(unw_local_addr_space, (unw_word_t) ip,
+                              &info, NULL) != 0) {
+    return -1;
+  }
+  *start = (uintptr_t) info.start_ip;
+  return 0;
+}
+#else
+static int proc_name_by_ip(uintptr_t ip, char *buf, size_t size,
+                           uintptr_t *offset)
+{
+  Dl_info info;
+  if (dladdr((void *) ip, &info) == 0 || info.dli_sname == NULL) {
+    return -1;
+  }
+  snprintf(buf, size, "%s", info.dli_sname);
+  *offset = ip - (uintptr_t) info.dli_saddr;
+  return 0;
+}
+
+static int proc_start_by_ip(uintptr_t ip, uintptr_t *start)
+{
+  Dl_info info;
+  if (dladdr((void *) ip, &info) == 0 || info.dli_saddr == NULL) {
+    return -1;
+  }
+  *start = (uintptr_t) info.dli_saddr;
+  return 0;
+}
+#endif
+
+// Describe the procedure named NAME in BUF, demangling IEPs, and give
+// its kind, as a DYLAN_SYMBOL does.
+static int describe_proc(const char *name, char *buf, size_t size)
+{
+  size_t namelen = strlen(name);
+  if (namelen > 0
+      && name[namelen - 1] == 'I'
+      && dylan_demangle(buf, size, (char *) name) == 0) {
+    return interesting_iep(buf);
+  }
+  snprintf(buf, size, "%s", name);
+  return interesting_function(name);
+}
+
+
+/// Symbol cache
+
+// The descriptions of the procedures symbolized so far, keyed by their
+// start addresses, so that each procedure is looked up and demangled
+// only once however many backtraces and profiles it appears in.  An
+// entry is claimed with a compare-and-swap and published with a release
+// store once it is filled in, and entries are never removed, so the
+// cache takes no locks.  Names are copied into a fixed arena rather
+// than the heap, so that a cached name stays valid for good.  Once
+// either the table or the arena is full, procedures are described afresh
+// every time.  A miss calls into libunwind or dladdr, so the cache must
+// not be used from a signal handler: the sampling profiler's handler
+// only records IPs, which are symbolized when the profile is written.
+
+#define SYMBOL_CACHE_BITS   14
+#define SYMBOL_CACHE_SIZE   (1 << SYMBOL_CACHE_BITS)
+#define SYMBOL_CACHE_PROBES 32
+#define SYMBOL_NAMES_SIZE   (1 << 20)
+
+enum { SYMBOL_EMPTY, SYMBOL_FILLING, SYMBOL_READY };
+
+typedef struct symbol_entry {
+  int state;
+  int kind;                     // as in DYLAN_SYMBOL
+  uintptr_t start;
+  const char *name;             // NULL if the procedure has no name
+} SYMBOL_ENTRY;
+
+static SYMBOL_ENTRY symbol_cache[SYMBOL_CACHE_SIZE];
+static char symbol_names[SYMBOL_NAMES_SIZE];
+static size_t symbol_names_used = 0;
+
+// Fibonacci hashing on the start with its alignment bits dropped.  The
+// index is the top bits of the product, since the low bits of a
+// product of aligned starts are always zero and would leave most of
+// the table unused.
+static size_t symbol_cache_hash(uintptr_t start)
+{
+  return (size_t) (((uint64_t) (start >> 4) * 0x9E3779B97F4A7C15u)
+                   >> (64 - SYMBOL_CACHE_BITS));
+}
+
+static const SYMBOL_ENTRY *symbol_cache_find(uintptr_t start)
+{
+  size_t i = symbol_cache_hash(start);
+  for (int probe = 0; probe < SYMBOL_CACHE_PROBES; ++probe) {
+    SYMBOL_ENTRY *entry = &symbol_cache[i];
+    int state = __atomic_load_n(&entry->state, __ATOMIC_ACQUIRE);
+    if (state == SYMBOL_EMPTY) {
+      return NULL;
+    }
+    if (state == SYMBOL_READY && entry->start == start) {
+      return entry;
+    }
+    i = (i + 1) & (SYMBOL_CACHE_SIZE - 1);
+  }
+  return NULL;
+}
+
+// Two threads that miss at the same time may both add the procedure,
+// which only wastes an entry.
+static const SYMBOL_ENTRY *symbol_cache_add(uintptr_t start, int kind,
+                                            const char *name)
+{
+  const char *copy = NULL;
+  if (name != NULL) {
+    size_t length = strlen(name) + 1;
+    size_t used = __atomic_fetch_add(&symbol_names_used, length,
+                                     __ATOMIC_RELAXED);
+    if (used + length > SYMBOL_NAMES_SIZE) {
+      return NULL;
+    }
+    memcpy(&symbol_names[used], name, length);
+    copy = &symbol_names[used];
+  }
+
+  size_t i = symbol_cache_hash(start);
+  for (int probe = 0; probe < SYMBOL_CACHE_PROBES; ++probe) {
+    SYMBOL_ENTRY *entry = &symbol_cache[i];
+    int empty = SYMBOL_EMPTY;
+    if (__atomic_compare_exchange_n(&entry->state, &empty, SYMBOL_FILLING,
+                                    0, __ATOMIC_RELAXED,
+                                    __ATOMIC_RELAXED)) {
+      entry->kind = kind;
+      entry->start = start;
+      entry->name = copy;
+      __atomic_store_n(&entry->state, SYMBOL_READY, __ATOMIC_RELEASE);
+      return entry;
+    }
+    i = (i + 1) & (SYMBOL_CACHE_SIZE - 1);
+  }
+  return NULL;
+}
+
+// Describe the frame at CURSOR, or if CURSOR is NULL the procedure
+// containing IP, through the cache.  BUF holds the name of a procedure
+// that could not be cached.
+static void symbolize_frame(unw_cursor_t *cursor, uintptr_t ip,
+                            DYLAN_SYMBOL *symbol, char *buf, size_t size)
+{
+  uintptr_t start = 0;
+  int have_start;
+  if (cursor != NULL) {
+    unw_proc_info_t info;
+    unw_word_t reg;
+    have_start = unw_get_proc_info(cursor, &info) == 0;
+    start = (uintptr_t) info.start_ip;
+    ip = unw_get_reg(cursor, UNW_REG_IP, &reg) == 0 ? (uintptr_t) reg : 0;
+  }
+  else {
+    have_start = proc_start_by_ip(ip, &start) == 0;
+  }
+  have_start = have_start && start != 0;
+
+  const SYMBOL_ENTRY *entry = have_start ? symbol_cache_find(start) : NULL;
+  if (entry == NULL) {
+    char name[256];
+    uintptr_t offset;
+    int found;
+    if (cursor != NULL) {
+      unw_word_t off;
+      found = unw_get_proc_name(cursor, name, sizeof name, &off) == 0;
+      offset = (uintptr_t) off;
+    }
+    else {
+      found = proc_name_by_ip(ip, name, sizeof name, &offset) == 0;
+    }
+
+    if (!found) {
+      if (have_start) {
+        symbol_cache_add(start, -1, NULL);
+      }
+      symbol->name = NULL;
+      symbol->offset = ip;
+      symbol->kind = -1;
+      return;
+    }
+
+    int kind = describe_proc(name, buf, size);
+    entry = have_start ? symbol_cache_add(start, kind, buf) : NULL;
+    if (entry == NULL) {
+      symbol->name = buf;
+      symbol->offset = offset;
+      symbol->kind = kind;
+      return;
+    }
+  }
+
+  symbol->name = entry->name;
+  symbol->offset = entry->name != NULL ? ip - start : ip;
+  symbol->kind = entry->kind;
+}
+
+int dylan_symbolize_ips(const uintptr_t *ips, DYLAN_SYMBOL *symbols, int count)
+{
+  int named = 0;
+  for (int i = 0; i < count; ++i) {
+    char buf[256];
+    symbolize_frame(NULL, ips[i], &symbols[i], buf, sizeof buf);
+    if (symbols[i].name == buf) {
+      // Not cached, so there is nowhere to keep the name
+      symbols[i].name = NULL;
+      symbols[i].offset = ips[i];
+      symbols[i].kind = -1;
+    }
+    if (symbols[i].name != NULL) {
+      ++named;
+    }
+  }
+  return named;
+}
+
+
+/// Stack walking
+
 void dylan_dump_callstack(void *ctxt)
 {
   unw_context_t context;
@@ -395,29 +640,15 @@ void dylan_dump_callstack(void *ctxt)
   int rc = unw_init_local(&cursor, ctxt);
   do {
     // Find a symbol for the current frame
-    unw_word_t offset;
+    DYLAN_SYMBOL symbol;
     char buf[256];
-    if (unw_get_proc_name(&cursor, buf, sizeof buf, &offset) == 0) {
-      // Is this an IEP?
-      size_t namelen = strlen(buf);
-      char demangled[256];
-      if (namelen > 0
-          && buf[namelen - 1] == 'I'
-          && dylan_demangle(demangled, sizeof demangled, buf) == 0) {
-        if (interesting_iep(demangled)) {
-          fprintf(stderr, "  %s + %#jx\n", demangled, (uintmax_t) offset);
-        }
-      }
-      else if (interesting_function(buf)) {
-        fprintf(stderr, "  %s + %#jx\n", buf, (uintmax_t) offset);
-      }
+    symbolize_frame(&cursor, 0, &symbol, buf, sizeof buf);
+    if (symbol.name == NULL) {
+      // Only the raw instruction pointer address is known
+      fprintf(stderr, "  %#jx\n", (uintmax_t) symbol.offset);
     }
-    else {
-      // Read the raw instruction pointer address
-      unw_word_t ip;
-      unw_get_reg(&cursor, UNW_REG_IP, &ip);
-
-      fprintf(stderr, "  %#jx\n", (uintmax_t) ip);
+    else if (symbol.kind > 0) {
+      fprintf(stderr, "  %s + %#jx\n", symbol.name, (uintmax_t) symbol.offset);
     }
 
     // On to the next enclosing frame
@@ -425,10 +656,104 @@ void dylan_dump_callstack(void *ctxt)
   } while (rc > 0);
 }
 
+// Frames belonging to the locks themselves, which say nothing about who
+// is waiting for one.  Only demangled IEP names contain colons.
+static int lock_frame(const char *name)
+{
+  const char suffix[] = ":threads-internal:dylan";
+  size_t suffix_len = strlen(suffix);
+  if (strchr(name, ':') != NULL) {
+    size_t name_len = strlen(name);
+    return name_len >= suffix_len
+      && strcmp(name + name_len - suffix_len, suffix) == 0;
+  }
+  return strncmp(name, "primitive_", 10) == 0
+    || strncmp(name, "lock_profile", 12) == 0
+    || strncmp(name, "futex_", 6) == 0
+    || strcmp(name, "dylan_callstack_site") == 0;
+}
+
+int dylan_callstack_site(char *buf, size_t size)
+{
+  unw_context_t context;
+  unw_cursor_t cursor;
+  unw_getcontext(&context);
+  if (unw_init_local(&cursor, &context) != 0) {
+    return -1;
+  }
+
+  do {
+    DYLAN_SYMBOL symbol;
+    char name[256];
+    symbolize_frame(&cursor, 0, &symbol, name, sizeof name);
+    if (symbol.name != NULL && symbol.kind > 0 && !lock_frame(symbol.name)) {
+      snprintf(buf, size, "%s + %#jx", symbol.name, (uintmax_t) symbol.offset);
+      return 0;
+    }
+  } while (unw_step(&cursor) > 0);
+
+  return -1;
+}
+
+int dylan_callstack_ips(uintptr_t *ips, int max)
+{
+  unw_context_t context;
+  unw_cursor_t cursor;
+  unw_getcontext(&context);
+  if (unw_init_local(&cursor, &context) != 0) {
+    return 0;
+  }
+
+  // Skip the signal handler's frames, up to and including the
+  // trampoline that the kernel returns through, if there is one.
+  unw_cursor_t start = cursor;
+  int signal_frame = 0;
+  for (int i = 0; i < 16 && !signal_frame; ++i) {
+    signal_frame = unw_is_signal_frame(&cursor) > 0;
+    if (unw_step(&cursor) <= 0) {
+      break;
+    }
+  }
+  if (!signal_frame) {
+    cursor = start;
+  }
+
+  int count = 0;
+  do {
+    unw_word_t ip;
+    if (unw_get_reg(&cursor, UNW_REG_IP, &ip) != 0 || ip == 0) {
+      break;
+    }
+    ips[count++] = (uintptr_t) ip;
+  } while (count < max && unw_step(&cursor) > 0);
+
+  return count;
+}
+
 #else  // !HAVE_LIBUNWIND_H
 
 void dylan_dump_callstack(void *ctxt)
 {
 }
 
+int dylan_callstack_site(char *buf, size_t size)
+{
+  return -1;
+}
+
+int dylan_callstack_ips(uintptr_t *ips, int max)
+{
+  return 0;
+}
+
+int dylan_symbolize_ips(const uintptr_t *ips, DYLAN_SYMBOL *symbols, int count)
+{
+  for (int i = 0; i < count; ++i) {
+    symbols[i].name = NULL;
+    symbols[i].offset = ips[i];
+    symbols[i].kind = -1;
+  }
+  return 0;
+}
+
 #endif
@@ -1,6 +1,46 @@
 #ifndef STACK_WALKER_H_
 #define STACK_WALKER_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
 extern void dylan_dump_callstack(void *ctxt);
 
+/* Describe the innermost frame of the current thread's stack outside the
+ * run-time and the threads library, for attributing a wait to the code
+ * that asked for the lock.  Returns 0 on success, or -1 if there is no
+ * such frame or no unwinder. */
+extern int dylan_callstack_site(char *buf, size_t size);
+
+/* Record the instruction pointers of the current thread's stack,
+ * innermost first, in IPS.  When called from a signal handler the
+ * handler's own frames are left out.  Safe to call from a signal
+ * handler.  Returns the number of frames recorded, at most MAX, which
+ * is 0 with no unwinder. */
+extern int dylan_callstack_ips(uintptr_t *ips, int max);
+
+/* Functions are symbolized, and IEP names demangled, once each: the
+ * descriptions are kept in a lock-free cache keyed by the functions'
+ * start addresses, which backtraces, lock profiles and CPU profiles
+ * share.  Symbolizing a function that is not in the cache yet looks it
+ * up with the unwinder or the dynamic linker, neither of which is safe
+ * in a signal handler, so a handler should only record IPs. */
+
+typedef struct dylan_symbol {
+  const char *name;             /* NULL if unknown */
+  uintptr_t offset;             /* into the function, or the IP if unknown */
+  int kind;                     /* 1 for a function worth showing, 0 for
+                                 * part of the dispatch engine or of the
+                                 * calling convention glue, and -1 if
+                                 * unknown */
+} DYLAN_SYMBOL;
+
+/* Describe the functions containing each of the COUNT instruction
+ * pointers IPS in SYMBOLS.  The names belong to the cache and stay valid
+ * for the life of the program; a function that does not fit in the
+ * cache is described as unknown.  Returns the number of functions
+ * named. */
+extern int dylan_symbolize_ips(const uintptr_t *ips, DYLAN_SYMBOL *symbols,
+                               int count);
+
 #endif // STACK_WALKER_H_
@@ -1,5 +1,7 @@
 #include "thread-utils.h"
 
+#include <string.h>
+
 #if defined(OPEN_DYLAN_PLATFORM_LINUX)
 #include <unistd.h>
 #include <sys/prctl.h>
@@ -19,6 +21,10 @@
 #include <windows.h>
 #endif
 
+#if !defined(OPEN_DYLAN_PLATFORM_WINDOWS)
+#include <unistd.h>
+#endif
+
 uint64_t dylan_current_thread_id(void)
 {
 #if defined(OPEN_DYLAN_PLATFORM_LINUX)
@@ -57,3 +63,43 @@ void dylan_set_current_thread_name(const char *name) {
   pthread_setname_np(name);
 #endif
 }
+
+/* Copy the current OS thread's name into BUFFER, and return its length,
+   or -1 if the name can't be read on this platform. */
+int dylan_current_thread_name(char *buffer, int size) {
+#if defined(OPEN_DYLAN_PLATFORM_LINUX)
+  char name[16 + 1] = { 0 };
+  if (size <= 0 || prctl(PR_GET_NAME, (unsigned long)name, 0, 0, 0) != 0) {
+    return -1;
+  }
+  strncpy(buffer, name, size - 1);
+  buffer[size - 1] = '\0';
+  return (int)strlen(buffer);
+#elif defined(OPEN_DYLAN_PLATFORM_FREEBSD)
+  if (size <= 0) {
+    return -1;
+  }
+  pthread_get_name_np(pthread_self(), buffer, size);
+  return (int)strlen(buffer);
+#elif defined(OPEN_DYLAN_PLATFORM_DARWIN)
+  if (size <= 0 || pthread_getname_np(pthread_self(), buffer, size) != 0) {
+    return -1;
+  }
+  return (int)strlen(buffer);
+#else
+  return -1;
+#endif
+}
+
+/* The number of processors available to run threads, or 0 if that
+   can't be told. */
+int dylan_concurrent_thread_count(void) {
+#if defined(OPEN_DYLAN_PLATFORM_WINDOWS)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return (int)info.dwNumberOfProcessors;
+#else
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count < 0 ? 0 : (int)count;
+#endif
+}
@@ -6,3 +6,5 @@ typedef unsigned __int64 uint64_t;
 
 uint64_t dylan_current_thread_id(void);
 void dylan_set_current_thread_name(const char *name);
+int dylan_current_thread_name(char *buffer, int size);
+int dylan_concurrent_thread_count(void);
@@ -1009,6 +1009,31 @@ primitive_sleep(ZINT zmilsecs)
 }
 
 
+/* Lock contention profiling is only implemented by the LLVM and C
+ * run-times, so these just say so. */
+THREADS_RUN_TIME_API  void
+primitive_start_lock_profiling(void)
+{
+  MSG0("start-lock-profiling: not supported by this run-time\n");
+}
+
+THREADS_RUN_TIME_API  void
+primitive_stop_lock_profiling(void)
+{
+}
+
+THREADS_RUN_TIME_API  void
+primitive_dump_lock_profile(void)
+{
+}
+
+THREADS_RUN_TIME_API  ZINT
+primitive_lock_contention_count(Z name)
+{
+  return (ZINT)I(0);
+}
+
+
 /* 31 */
 /*
 Z
@@ -1018,12 +1043,11 @@ primitive_assign_atomic_memory(void * * location, Z newval)
 */
 
 /* 32 */
-/*
-ZINT
+THREADS_RUN_TIME_API  ZINT
 primitive_conditional_update_memory(void * * location, Z newval, Z oldval)
 {
+  return __sync_bool_compare_and_swap(location, oldval, newval);
 }
-*/
 
 
 /* 33 */
@@ -218,6 +218,18 @@ primitive_destroy_notification(CONTAINER * notif);
 THREADS_RUN_TIME_API  void
 primitive_sleep(ZINT milsecs);
 
+THREADS_RUN_TIME_API  void
+primitive_start_lock_profiling(void);
+
+THREADS_RUN_TIME_API  void
+primitive_stop_lock_profiling(void);
+
+THREADS_RUN_TIME_API  void
+primitive_dump_lock_profile(void);
+
+THREADS_RUN_TIME_API  ZINT
+primitive_lock_contention_count(Z name);
+
 THREADS_RUN_TIME_API  ZINT
 primitive_owned_simple_lock(CONTAINER * lock);
 
@@ -227,10 +239,10 @@ primitive_owned_recursive_lock(CONTAINER * rlock);
 /*
 THREADS_RUN_TIME_API  Z
 primitive_assign_atomic_memory(void * * location, Z newval);
+*/
 
 THREADS_RUN_TIME_API  ZINT
 primitive_conditional_update_memory(void * * location, Z newval, Z oldval);
-*/
 
 THREADS_RUN_TIME_API  void*
 primitive_allocate_thread_variable(Z value);
@@ -1,15 +1,26 @@
 #ifdef __APPLE__
 #define _DARWIN_C_SOURCE
 #endif
+#ifdef __linux__
+#define _GNU_SOURCE
+#endif
 
 #include <unistd.h>
 #include <signal.h>
 #include <errno.h>
 #include <dlfcn.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <spawn.h>
 #include <sys/stat.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <stdint.h>
+#include <sys/syscall.h>
+#endif
 
 #ifdef __APPLE__
 #include <crt_externs.h>
@@ -38,6 +49,166 @@ int system_unsetenv(const char *name)
   return unsetenv(name);
 }
 
+/* Process creation.
+ *
+ * Where posix_spawn can do everything the child needs, including
+ * closing every descriptor above stderr, we use it.  Otherwise we vfork
+ * and close the descriptors ourselves, with close_range, closefrom or a
+ * scan of /proc/self/fd when available rather than one close per
+ * possible descriptor number (which can be millions under a high
+ * RLIMIT_NOFILE).
+ */
+
+#if defined(__GLIBC__) && defined(__GLIBC_PREREQ)
+#if __GLIBC_PREREQ(2, 34)
+#define SYSTEM_SPAWN_CLOSEFROM 1
+#endif
+#if __GLIBC_PREREQ(2, 29)
+#define SYSTEM_SPAWN_CHDIR 1
+#endif
+#endif
+
+#if defined(__APPLE__) && defined(POSIX_SPAWN_CLOEXEC_DEFAULT)
+#define SYSTEM_SPAWN_CLOEXEC_DEFAULT 1
+#if defined(__MAC_OS_X_VERSION_MIN_REQUIRED) \
+  && __MAC_OS_X_VERSION_MIN_REQUIRED >= 101500
+#define SYSTEM_SPAWN_CHDIR 1
+#endif
+#endif
+
+#if defined(SYSTEM_SPAWN_CLOSEFROM) || defined(SYSTEM_SPAWN_CLOEXEC_DEFAULT)
+
+/* Returns 0 on success or an error number, in which case no child is
+ * left behind.
+ */
+static int system_posix_spawn(pid_t *pid, char *program, char **argv,
+                              char **envp, char *dir, int inherit_console,
+                              int stdin_fd, int stdout_fd, int stderr_fd)
+{
+  posix_spawn_file_actions_t actions;
+  posix_spawnattr_t attr;
+  sigset_t sset;
+  short flags = POSIX_SPAWN_SETSIGMASK;
+  int result;
+
+#ifndef SYSTEM_SPAWN_CHDIR
+  if (dir)
+    return ENOSYS;
+#endif
+#ifdef POSIX_SPAWN_SETSID
+  if (!inherit_console)
+    flags |= POSIX_SPAWN_SETSID;
+#else
+  if (!inherit_console)
+    return ENOSYS;
+#endif
+
+  result = posix_spawn_file_actions_init(&actions);
+  if (result != 0)
+    return result;
+  result = posix_spawnattr_init(&attr);
+  if (result != 0) {
+    posix_spawn_file_actions_destroy(&actions);
+    return result;
+  }
+
+#ifdef SYSTEM_SPAWN_CHDIR
+  if (dir && result == 0)
+    result = posix_spawn_file_actions_addchdir_np(&actions, dir);
+#endif
+  if (stdin_fd >= 0 && result == 0)
+    result = posix_spawn_file_actions_adddup2(&actions, stdin_fd, 0);
+  if (stdout_fd >= 0 && result == 0)
+    result = posix_spawn_file_actions_adddup2(&actions, stdout_fd, 1);
+  if (stderr_fd >= 0 && result == 0)
+    result = posix_spawn_file_actions_adddup2(&actions, stderr_fd, 2);
+
+#ifdef SYSTEM_SPAWN_CLOSEFROM
+  if (result == 0)
+    result = posix_spawn_file_actions_addclosefrom_np(&actions, 3);
+#else
+  /* Everything not explicitly inherited is closed on exec. */
+  flags |= POSIX_SPAWN_CLOEXEC_DEFAULT;
+  if (stdin_fd < 0 && result == 0)
+    result = posix_spawn_file_actions_addinherit_np(&actions, 0);
+  if (stdout_fd < 0 && result == 0)
+    result = posix_spawn_file_actions_addinherit_np(&actions, 1);
+  if (stderr_fd < 0 && result == 0)
+    result = posix_spawn_file_actions_addinherit_np(&actions, 2);
+#endif
+
+  /* unblock signals */
+  sigemptyset(&sset);
+  if (result == 0)
+    result = posix_spawnattr_setsigmask(&attr, &sset);
+  if (result == 0)
+    result = posix_spawnattr_setflags(&attr, flags);
+
+  if (result == 0)
+    result = posix_spawn(pid, program, &actions, &attr, argv, envp);
+
+  posix_spawnattr_destroy(&attr);
+  posix_spawn_file_actions_destroy(&actions);
+  return result;
+}
+
+#endif
+
+/* Close every descriptor from LOWFD up.  This runs in a vfork child, so
+ * it must stick to async-signal-safe calls and not allocate.
+ */
+static void system_close_fds_from(int lowfd)
+{
+  int fd;
+
+#if defined(__linux__) && defined(SYS_close_range)
+  if (syscall(SYS_close_range, (unsigned int) lowfd, ~0U, 0) == 0)
+    return;
+#endif
+
+#if defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
+  closefrom(lowfd);
+  return;
+#endif
+
+#if defined(__linux__) && defined(SYS_getdents64)
+  {
+    int dirfd = open("/proc/self/fd", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd >= 0) {
+      char buffer[4096];
+      long count;
+      while ((count = syscall(SYS_getdents64, dirfd, buffer, sizeof(buffer))) > 0) {
+        long offset = 0;
+        while (offset < count) {
+          struct {
+            uint64_t d_ino;
+            int64_t d_off;
+            unsigned short d_reclen;
+            unsigned char d_type;
+            char d_name[];
+          } *entry = (void *) (buffer + offset);
+          const char *p = entry->d_name;
+          fd = 0;
+          if (*p >= '0' && *p <= '9') {
+            while (*p >= '0' && *p <= '9')
+              fd = fd * 10 + (*p++ - '0');
+            if (fd >= lowfd && fd != dirfd)
+              close(fd);
+          }
+          offset += entry->d_reclen;
+        }
+      }
+      close(dirfd);
+      if (count == 0)
+        return;
+    }
+  }
+#endif
+
+  for (fd = sysconf(_SC_OPEN_MAX) - 1; fd >= lowfd; fd--)
+    close(fd);
+}
+
 /* Adapted from the SBCL run-time system, which in turn is derived
  * from the CMU CL system, which was written at Carnegie Mellon
  * University and released into the public domain.
@@ -46,10 +217,21 @@ int system_spawn(char *program, char **argv, char **envp, char *dir,
                  int inherit_console,
                  int stdin_fd, int stdout_fd, int stderr_fd)
 {
-  int pid = vfork();
-  int fd;
+  int pid;
   sigset_t sset;
 
+#if defined(SYSTEM_SPAWN_CLOSEFROM) || defined(SYSTEM_SPAWN_CLOEXEC_DEFAULT)
+  {
+    pid_t child;
+    /* If this fails, including because the exec failed, carry on the
+       old way so the caller still sees a child exiting with 127. */
+    if (system_posix_spawn(&child, program, argv, envp, dir, inherit_console,
+                           stdin_fd, stdout_fd, stderr_fd) == 0)
+      return child;
+  }
+#endif
+
+  pid = vfork();
   if (pid != 0)
     return pid;
 
@@ -77,8 +259,7 @@ int system_spawn(char *program, char **argv, char **envp, char *dir,
     dup2(stderr_fd, 2);
 
   /* Close all other fds. */
-  for (fd = sysconf(_SC_OPEN_MAX) - 1; fd > 2; fd--)
-    close(fd);
+  system_close_fds_from(3);
 
   /* Exec the program. */
   execve(program, argv, envp);
@@ -112,6 +293,149 @@ const char *system_dirent_name(struct dirent *dirent)
   return dirent->d_name;
 }
 
+/* Batched directory enumeration.  Each call packs as many entries as
+ * will fit into the caller's buffer, each one a type byte followed by
+ * the NUL-terminated name, so a directory costs one call per buffer
+ * rather than one per entry.  The type comes from d_type where the file
+ * system supplies it, and from an fstatat relative to the directory
+ * otherwise.  "." and ".." are skipped.
+ */
+
+#define SYSTEM_DIRENT_FILE      0
+#define SYSTEM_DIRENT_DIRECTORY 1
+#define SYSTEM_DIRENT_LINK      2
+
+struct system_directory {
+  DIR *dir;
+  struct dirent *pending;       /* read, but didn't fit in the last batch */
+};
+
+/* Open NAME relative to the directory DIRFD, or relative to the working
+ * directory if DIRFD is negative.  Subdirectories opened relative to
+ * their parent are never reached through a symbolic link.
+ */
+void *system_open_directory_at(int dirfd, const char *name)
+{
+  int flags = O_RDONLY | O_DIRECTORY;
+  int fd;
+  DIR *dir;
+  struct system_directory *handle;
+
+#ifdef O_CLOEXEC
+  flags |= O_CLOEXEC;
+#endif
+  if (dirfd < 0)
+    dirfd = AT_FDCWD;
+  else
+    flags |= O_NOFOLLOW;
+
+  fd = openat(dirfd, name, flags);
+  if (fd < 0)
+    return NULL;
+  dir = fdopendir(fd);
+  if (dir == NULL) {
+    close(fd);
+    return NULL;
+  }
+  handle = malloc(sizeof(struct system_directory));
+  if (handle == NULL) {
+    closedir(dir);
+    errno = ENOMEM;
+    return NULL;
+  }
+  handle->dir = dir;
+  handle->pending = NULL;
+  return handle;
+}
+
+int system_directory_fd(void *handle)
+{
+  return dirfd(((struct system_directory *) handle)->dir);
+}
+
+int system_close_directory(void *handle)
+{
+  int result = closedir(((struct system_directory *) handle)->dir);
+  free(handle);
+  return result;
+}
+
+static int system_dirent_type(DIR *dir, struct dirent *entry)
+{
+  struct stat st;
+
+#ifdef DT_UNKNOWN
+  switch (entry->d_type) {
+  case DT_DIR:
+    return SYSTEM_DIRENT_DIRECTORY;
+  case DT_LNK:
+    return SYSTEM_DIRENT_LINK;
+  case DT_UNKNOWN:
+    break;
+  default:
+    return SYSTEM_DIRENT_FILE;
+  }
+#endif
+  if (fstatat(dirfd(dir), entry->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+    return -1;
+  if (S_ISDIR(st.st_mode))
+    return SYSTEM_DIRENT_DIRECTORY;
+  if (S_ISLNK(st.st_mode))
+    return SYSTEM_DIRENT_LINK;
+  return SYSTEM_DIRENT_FILE;
+}
+
+/* Returns the number of bytes used, 0 at the end of the directory and
+ * -1 (with errno set) on failure.
+ */
+int system_read_directory(void *handle, char *buffer, int size)
+{
+  struct system_directory *d = handle;
+  int used = 0;
+
+  for (;;) {
+    struct dirent *entry = d->pending;
+    const char *name;
+    size_t length;
+    int type;
+
+    if (entry != NULL) {
+      d->pending = NULL;
+    } else {
+      errno = 0;
+      entry = readdir(d->dir);
+      if (entry == NULL)
+        return (errno == 0) ? used : -1;
+    }
+
+    name = entry->d_name;
+    if (name[0] == '.'
+        && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0')))
+      continue;
+
+    length = strlen(name);
+    if (used + length + 2 > (size_t) size) {
+      if (used == 0) {
+        errno = ENAMETOOLONG;
+        return -1;
+      }
+      d->pending = entry;
+      return used;
+    }
+
+    type = system_dirent_type(d->dir, entry);
+    if (type < 0) {
+      if (errno == ENOENT)      /* deleted since we read it */
+        continue;
+      return -1;
+    }
+
+    buffer[used] = (char) type;
+    memcpy(buffer + used + 1, name, length + 1);
+    used += length + 2;
+  }
+}
+
 int system_stat(const char* path, struct stat* buf)
 {
   return stat(path, buf);